@@ -1,7 +1,19 @@
 #include <benchmark/benchmark.h>
+#include <cstring>
 #include <fstream>
+#include <random>
+#include <gzip/allocator.hpp>
+#include <gzip/batch.hpp>
+#include <gzip/buffer.hpp>
+#include <gzip/chunked_buffer.hpp>
 #include <gzip/compress.hpp>
 #include <gzip/decompress.hpp>
+#include <gzip/dictionary_trainer.hpp>
+#include <gzip/index.hpp>
+#include <gzip/parallel_compress.hpp>
+#include <gzip/parallel_decompress.hpp>
+#include <gzip/speculative_decompress.hpp>
+#include <gzip/thread_pool.hpp>
 
 static std::string open_file(std::string const& filename)
 {
@@ -16,6 +28,48 @@ static std::string open_file(std::string const& filename)
     return data;
 }
 
+static std::string make_random_data(std::size_t size)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::string data(size, '\0');
+    for (auto& c : data)
+    {
+        c = static_cast<char>(distribution(generator));
+    }
+    return data;
+}
+
+// Builds data that deflates at roughly ratio:1 by following a run of random bytes with zeros
+static std::string make_compressible_data(std::size_t size, std::size_t ratio)
+{
+    std::string data = make_random_data(size);
+    constexpr std::size_t block = 4096;
+    std::size_t random_bytes = block / ratio;
+    for (std::size_t i = 0; i < size; i += block)
+    {
+        for (std::size_t j = i + random_bytes; j < i + block && j < size; ++j)
+        {
+            data[j] = '\0';
+        }
+    }
+    return data;
+}
+
+// Repeats the tile fixture until the buffer reaches size bytes
+static std::string make_large_data(std::size_t size)
+{
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::string data;
+    data.reserve(size + tile.size());
+    while (data.size() < size)
+    {
+        data += tile;
+    }
+    data.resize(size);
+    return data;
+}
+
 static void BM_compress(benchmark::State& state) // NOLINT google-runtime-references
 {
     std::string buffer = open_file("./bench/14-4685-6265.mvt");
@@ -72,6 +126,302 @@ static void BM_compress_class_no_reallocations(benchmark::State& state) // NOLIN
 
 BENCHMARK(BM_compress_class_no_reallocations);
 
+// range(0) selects compressing into a string and copying it to a preallocated send
+// buffer (0) or compressing straight into that buffer with compress_into (1)
+static void BM_compress_into(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer = open_file("./bench/14-4685-6265.mvt");
+    gzip::Compressor comp;
+    std::vector<char> send(buffer.size() + 1024);
+    std::string output;
+
+    for (auto _ : state)
+    {
+        if (state.range(0) == 0)
+        {
+            comp.compress(output, buffer.data(), buffer.size());
+            std::memcpy(send.data(), output.data(), output.size());
+        }
+        else
+        {
+            gzip::WriteResult result = comp.compress_into(send.data(), send.size(), buffer.data(), buffer.size());
+            benchmark::DoNotOptimize(result);
+        }
+    }
+}
+
+BENCHMARK(BM_compress_into)->Arg(0)->Arg(1);
+
+// An HTTP style response of many fragments: range(0) selects gathering them into one
+// string before compressing (0) or compressing the segments as they are (1)
+static void BM_compress_segments(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer = open_file("./bench/14-4685-6265.mvt");
+    std::vector<gzip::Segment> segments;
+    for (std::size_t offset = 0; offset < buffer.size(); offset += 700)
+    {
+        segments.push_back(gzip::Segment{&buffer[offset], std::min<std::size_t>(700, buffer.size() - offset)});
+    }
+    gzip::Compressor comp(1);
+    std::string output;
+
+    for (auto _ : state)
+    {
+        if (state.range(0) == 0)
+        {
+            std::string gathered;
+            for (auto const& segment : segments)
+            {
+                gathered.append(static_cast<const char*>(segment.iov_base), segment.iov_len);
+            }
+            comp.compress(output, gathered.data(), gathered.size());
+        }
+        else
+        {
+            comp.compress(output, segments.data(), segments.size());
+        }
+    }
+}
+
+BENCHMARK(BM_compress_segments)->Arg(0)->Arg(1);
+
+static void BM_compress_class_new_instance(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer = open_file("./bench/14-4685-6265.mvt");
+    std::string output;
+
+    // Baseline for BM_compress_class_no_reallocations: a fresh Compressor
+    // pays deflateInit2/deflateEnd and the deflate state allocation every iteration
+    for (auto _ : state)
+    {
+        gzip::Compressor comp;
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+}
+
+BENCHMARK(BM_compress_class_new_instance);
+
+static void BM_compress_class_new_instance_allocator(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // BM_compress_class_new_instance with the deflate state from range(0) = 0: an arena, 1: a slab pool
+    std::string buffer = open_file("./bench/14-4685-6265.mvt");
+    std::string output;
+    gzip::ArenaAllocator arena;
+    gzip::SlabPool pool(1);
+    gzip::Allocator* allocator = state.range(0) == 0 ? static_cast<gzip::Allocator*>(&arena) : &pool;
+
+    for (auto _ : state)
+    {
+        gzip::Compressor comp(Z_DEFAULT_COMPRESSION, 2000000000, allocator);
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+}
+
+BENCHMARK(BM_compress_class_new_instance_allocator)->Arg(0)->Arg(1);
+
+// 4Kb slices from the second half of the tile fixture, with the first 32Kb as the preset dictionary
+static std::vector<std::string> make_tile_slices(std::string const& tile)
+{
+    std::vector<std::string> slices;
+    for (std::size_t at = 32768; at + 4096 <= tile.size(); at += 4096)
+    {
+        slices.push_back(tile.substr(at, 4096));
+    }
+    return slices;
+}
+
+static void BM_compress_dictionary(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) = 0 compresses each slice as plain zlib, 1 against the preset dictionary
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::vector<std::string> slices = make_tile_slices(tile);
+    gzip::Dictionary dictionary(tile.data(), 32768);
+    gzip::Compressor plain(Z_DEFAULT_COMPRESSION);
+    gzip::Compressor primed(dictionary);
+    gzip::Compressor& comp = state.range(0) ? primed : plain;
+    std::string output;
+    std::size_t compressed = 0;
+    std::size_t uncompressed = 0;
+
+    for (auto _ : state)
+    {
+        for (auto const& slice : slices)
+        {
+            comp.compress(output, slice.data(), slice.size());
+            compressed += output.size();
+            uncompressed += slice.size();
+        }
+    }
+    state.counters["ratio"] = static_cast<double>(uncompressed) / static_cast<double>(compressed);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(slices.size()));
+}
+
+BENCHMARK(BM_compress_dictionary)->Arg(0)->Arg(1);
+
+static void BM_decompress_dictionary(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) = 0 decompresses plain gzip slices, 1 slices compressed against the preset dictionary
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::vector<std::string> slices = make_tile_slices(tile);
+    gzip::Dictionary dictionary(tile.data(), 32768);
+    gzip::Compressor comp(dictionary);
+    for (auto& slice : slices)
+    {
+        std::string compressed;
+        if (state.range(0))
+        {
+            comp.compress(compressed, slice.data(), slice.size());
+        }
+        else
+        {
+            compressed = gzip::compress(slice.data(), slice.size());
+        }
+        slice.swap(compressed);
+    }
+    gzip::Decompressor plain;
+    gzip::Decompressor primed(dictionary);
+    gzip::Decompressor& decomp = state.range(0) ? primed : plain;
+    std::string output;
+
+    for (auto _ : state)
+    {
+        for (auto const& slice : slices)
+        {
+            decomp.decompress(output, slice.data(), slice.size());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(slices.size()));
+}
+
+BENCHMARK(BM_decompress_dictionary)->Arg(0)->Arg(1);
+
+// Small JSON features drawing their keys from a skewed vocabulary, like API responses
+static std::vector<std::string> make_feature_payloads(std::size_t count, std::uint32_t seed)
+{
+    static const char* words[] = {"name", "class", "highway", "layer", "road", "street", "building", "height", "level", "amenity",
+                                  "shop", "cafe", "restaurant", "address", "city", "postcode", "country", "water", "river", "landuse"};
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> fields(5, 30);
+    std::uniform_int_distribution<int> values(0, 1000000);
+    std::geometric_distribution<int> keys(0.02);
+    std::vector<std::string> payloads;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string payload = "{";
+        for (int field = fields(generator); field > 0; --field)
+        {
+            int key = std::min(keys(generator), 399);
+            payload += std::string("\"") + words[key % 20] + "_" + words[key / 20] + "\":" + std::to_string(values(generator)) + ",";
+        }
+        payloads.push_back(payload + "\"type\":\"Feature\"}");
+    }
+    return payloads;
+}
+
+static void BM_train_dictionary(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::vector<std::string> samples = make_feature_payloads(3000, 1);
+    std::size_t bytes = 0;
+    for (auto const& sample : samples)
+    {
+        bytes += sample.size();
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(gzip::train_dictionary(samples));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+}
+
+BENCHMARK(BM_train_dictionary)->Unit(benchmark::kMillisecond);
+
+static void BM_compress_trained_dictionary(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) = 0 compresses held out payloads as plain zlib, 1 against a dictionary trained on 3000 samples
+    gzip::Dictionary dictionary = gzip::train_dictionary(make_feature_payloads(3000, 1));
+    std::vector<std::string> payloads = make_feature_payloads(1000, 2);
+    gzip::Compressor plain(Z_DEFAULT_COMPRESSION);
+    gzip::Compressor primed(dictionary);
+    gzip::Compressor& comp = state.range(0) ? primed : plain;
+    std::string output;
+    std::size_t compressed = 0;
+    std::size_t uncompressed = 0;
+
+    for (auto _ : state)
+    {
+        for (auto const& payload : payloads)
+        {
+            comp.compress(output, payload.data(), payload.size());
+            compressed += output.size();
+            uncompressed += payload.size();
+        }
+    }
+    state.counters["ratio"] = static_cast<double>(uncompressed) / static_cast<double>(compressed);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(payloads.size()));
+}
+
+BENCHMARK(BM_compress_trained_dictionary)->Arg(0)->Arg(1);
+
+static void BM_decompress_trained_dictionary(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) = 0 decompresses plain zlib payloads, 1 payloads compressed against the trained dictionary
+    gzip::Dictionary dictionary = gzip::train_dictionary(make_feature_payloads(3000, 1));
+    gzip::Dictionary none("", 0);
+    std::vector<std::string> payloads = make_feature_payloads(1000, 2);
+    gzip::Compressor comp(state.range(0) ? dictionary : none);
+    for (auto& payload : payloads)
+    {
+        std::string compressed;
+        comp.compress(compressed, payload.data(), payload.size());
+        payload.swap(compressed);
+    }
+    gzip::Decompressor decomp(state.range(0) ? dictionary : none);
+    std::string output;
+
+    for (auto _ : state)
+    {
+        for (auto const& payload : payloads)
+        {
+            decomp.decompress(output, payload.data(), payload.size());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(payloads.size()));
+}
+
+BENCHMARK(BM_decompress_trained_dictionary)->Arg(0)->Arg(1);
+
+static void BM_compress_class_incompressible(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // Random bytes compress to slightly more than their input size, the worst case for output sizing
+    std::string buffer = make_random_data(static_cast<std::size_t>(state.range(0)));
+    gzip::Compressor comp;
+    std::string output;
+
+    for (auto _ : state)
+    {
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_compress_class_incompressible)->Arg(16 * 1024)->Arg(1024 * 1024);
+
+static void BM_compress_class_already_compressed(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Compressor comp;
+
+    for (auto _ : state)
+    {
+        std::string output;
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+}
+
+BENCHMARK(BM_compress_class_already_compressed);
+
 static void BM_decompress_class(benchmark::State& state) // NOLINT google-runtime-references
 {
 
@@ -88,6 +438,57 @@ static void BM_decompress_class(benchmark::State& state) // NOLINT google-runtim
 
 BENCHMARK(BM_decompress_class);
 
+// Arg 0 is gzip, 1 zlib and 2 raw deflate, which skips computing any checksum
+template <typename Format>
+static void compress_format_loop(benchmark::State& state, std::string const& buffer) // NOLINT google-runtime-references
+{
+    gzip::BasicCompressor<Format> comp;
+    std::string output;
+    for (auto _ : state)
+    {
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+}
+
+static void BM_compress_format(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer = open_file("./bench/14-4685-6265.mvt");
+    switch (state.range(0))
+    {
+    case 0: compress_format_loop<gzip::GzipFormat<>>(state, buffer); break;
+    case 1: compress_format_loop<gzip::ZlibFormat<>>(state, buffer); break;
+    default: compress_format_loop<gzip::RawFormat<>>(state, buffer); break;
+    }
+}
+
+BENCHMARK(BM_compress_format)->Arg(0)->Arg(1)->Arg(2);
+
+template <typename Format>
+static void decompress_format_loop(benchmark::State& state, std::string const& buffer_uncompressed) // NOLINT google-runtime-references
+{
+    std::string buffer;
+    gzip::BasicCompressor<Format>().compress(buffer, buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::BasicDecompressor<Format> decomp;
+    std::string output;
+    for (auto _ : state)
+    {
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+}
+
+static void BM_decompress_format(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    switch (state.range(0))
+    {
+    case 0: decompress_format_loop<gzip::GzipFormat<>>(state, buffer_uncompressed); break;
+    case 1: decompress_format_loop<gzip::ZlibFormat<>>(state, buffer_uncompressed); break;
+    default: decompress_format_loop<gzip::RawFormat<>>(state, buffer_uncompressed); break;
+    }
+}
+
+BENCHMARK(BM_decompress_format)->Arg(0)->Arg(1)->Arg(2);
+
 static void BM_decompress_class_no_reallocations(benchmark::State& state) // NOLINT google-runtime-references
 {
 
@@ -106,6 +507,371 @@ static void BM_decompress_class_no_reallocations(benchmark::State& state) // NOL
 
 BENCHMARK(BM_decompress_class_no_reallocations);
 
+static void BM_decompress_into(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp;
+    std::vector<char> output(buffer_uncompressed.size());
+
+    for (auto _ : state)
+    {
+        gzip::WriteResult result = decomp.decompress_into(output.data(), output.size(), buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+BENCHMARK(BM_decompress_into);
+
+// range(0) selects decompressing into a std::string and copying it into the byte vector
+// the caller needs (0) or decompressing into that vector directly (1)
+static void BM_decompress_byte_vector(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp;
+    std::string staging;
+    std::vector<std::uint8_t> output;
+
+    for (auto _ : state)
+    {
+        if (state.range(0) == 0)
+        {
+            decomp.decompress(staging, buffer.data(), buffer.size());
+            output.assign(staging.begin(), staging.end());
+        }
+        else
+        {
+            decomp.decompress(output, buffer.data(), buffer.size());
+        }
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+
+BENCHMARK(BM_decompress_byte_vector)->Arg(0)->Arg(1);
+
+static void BM_decompress_class_new_instance(benchmark::State& state) // NOLINT google-runtime-references
+{
+
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    std::string output;
+
+    // Baseline for BM_decompress_class_no_reallocations: a fresh Decompressor
+    // pays inflateInit2/inflateEnd and the 32Kb window allocation every iteration
+    for (auto _ : state)
+    {
+        gzip::Decompressor decomp;
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+}
+
+BENCHMARK(BM_decompress_class_new_instance);
+
+static void BM_decompress_class_isize(benchmark::State& state) // NOLINT google-runtime-references
+{
+
+    std::string buffer_uncompressed = open_file("./bench/14-4685-6265.mvt");
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp(1000000000, true);
+
+    for (auto _ : state)
+    {
+        std::string output;
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+}
+
+BENCHMARK(BM_decompress_class_isize);
+
+static void BM_decompress_class_growth_policy(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) is the compression ratio, range(1) selects geometric (0) or the old fixed 2 * size step (1)
+    std::string buffer_uncompressed = make_compressible_data(4 * 1024 * 1024, static_cast<std::size_t>(state.range(0)));
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp(1000000000, false, state.range(1) == 0 ? gzip::GrowthPolicy::geometric() : gzip::GrowthPolicy::fixed());
+
+    for (auto _ : state)
+    {
+        std::string output;
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_class_growth_policy)
+    ->Args({2, 0})
+    ->Args({2, 1})
+    ->Args({10, 0})
+    ->Args({10, 1})
+    ->Args({100, 0})
+    ->Args({100, 1})
+    ->Args({1000, 0})
+    ->Args({1000, 1});
+
+// Decompresses into an output cleared each iteration, as pooled buffers are: range(0)
+// selects std::string (0), whose resize zero fills every byte before inflate writes it,
+// or gzip::Buffer (1). Fresh allocations gain little, as the kernel zeroes new pages anyway.
+template <typename OutputType>
+static void decompress_output_loop(benchmark::State& state, std::string const& buffer) // NOLINT google-runtime-references
+{
+    gzip::Decompressor decomp(1000000000, true);
+    OutputType output;
+    for (auto _ : state)
+    {
+        output.clear();
+        decomp.decompress(output, buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+
+static void BM_decompress_output_buffer(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = make_compressible_data(64 * 1024 * 1024, 100);
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    if (state.range(0) == 0)
+    {
+        decompress_output_loop<std::string>(state, buffer);
+    }
+    else
+    {
+        decompress_output_loop<gzip::Buffer>(state, buffer);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_output_buffer)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// range(0) selects a std::string grown geometrically (0), whose every reallocation copies
+// what was already decompressed, or a ChunkedBuffer of 1Mb chunks taken from a pool (1)
+static void BM_decompress_chunked(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = make_compressible_data(128 * 1024 * 1024, 100);
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp;
+    gzip::ChunkPool pool;
+
+    for (auto _ : state)
+    {
+        if (state.range(0) == 0)
+        {
+            std::string output;
+            decomp.decompress(output, buffer.data(), buffer.size());
+            benchmark::DoNotOptimize(output.data());
+        }
+        else
+        {
+            gzip::ChunkedBuffer output(pool);
+            decomp.decompress(output, buffer.data(), buffer.size());
+            benchmark::DoNotOptimize(output.segments().data());
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_chunked)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+template <typename OutputType>
+static void compress_output_loop(benchmark::State& state, std::string const& buffer) // NOLINT google-runtime-references
+{
+    gzip::Compressor comp(1);
+    OutputType output;
+    for (auto _ : state)
+    {
+        output.clear();
+        comp.compress(output, buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(output.data());
+    }
+}
+
+static void BM_compress_output_buffer(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // incompressible input makes deflateBound, the size resized to up front, about the input size
+    std::string buffer = make_compressible_data(16 * 1024 * 1024, 1);
+    if (state.range(0) == 0)
+    {
+        compress_output_loop<std::string>(state, buffer);
+    }
+    else
+    {
+        compress_output_loop<gzip::Buffer>(state, buffer);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer.size()));
+}
+
+BENCHMARK(BM_compress_output_buffer)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_compress_parallel(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) is the number of worker threads
+    std::string buffer = make_large_data(64 * 1024 * 1024);
+    gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, static_cast<std::size_t>(state.range(0)));
+    std::string output;
+
+    for (auto _ : state)
+    {
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer.size()));
+}
+
+BENCHMARK(BM_compress_parallel)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_compress_parallel_pool(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // Many small parallel calls on 4 workers: range(0) = 0 starts threads per call, 1 reuses a ThreadPool
+    std::string buffer = make_large_data(1024 * 1024);
+    gzip::ThreadPool pool(3);
+    gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, 4, 128 * 1024, 2000000000, state.range(0) ? &pool : nullptr);
+    std::string output;
+
+    for (auto _ : state)
+    {
+        comp.compress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer.size()));
+}
+
+BENCHMARK(BM_compress_parallel_pool)->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_decompress_parallel(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) is the number of worker threads, the index has a checkpoint every 1Mb
+    std::string buffer_uncompressed = make_large_data(64 * 1024 * 1024);
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Index index = gzip::Index::build(buffer.data(), buffer.size(), 1024 * 1024);
+    gzip::ParallelDecompressor decomp(static_cast<std::size_t>(state.range(0)));
+    std::string output;
+
+    for (auto _ : state)
+    {
+        decomp.decompress(output, buffer.data(), buffer.size(), index);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_parallel)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Synthetic JSON lines: varied enough that deflate emits ordinary dynamic blocks
+static std::string make_records_data(std::size_t size)
+{
+    std::string data;
+    data.reserve(size + 128);
+    std::uint32_t seed = 3;
+    while (data.size() < size)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        data += "{\"id\":" + std::to_string(seed % 100000) + ",\"name\":\"item" + std::to_string(seed >> 24) + "\"}\n";
+    }
+    data.resize(size);
+    return data;
+}
+
+static void BM_decompress_speculative(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // range(0) is the number of worker threads, compare against BM_decompress_serial_large
+    std::string buffer_uncompressed = make_records_data(256 * 1024 * 1024);
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::SpeculativeDecompressor decomp(static_cast<std::size_t>(state.range(0)));
+    std::string output;
+
+    for (auto _ : state)
+    {
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_speculative)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_decompress_serial_large(benchmark::State& state) // NOLINT google-runtime-references
+{
+    std::string buffer_uncompressed = make_records_data(256 * 1024 * 1024);
+    std::string buffer = gzip::compress(buffer_uncompressed.data(), buffer_uncompressed.size());
+    gzip::Decompressor decomp;
+    std::string output;
+
+    for (auto _ : state)
+    {
+        decomp.decompress(output, buffer.data(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(buffer_uncompressed.size()));
+}
+
+BENCHMARK(BM_decompress_serial_large)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_compress_batch(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // 10k tiles in one batch, range(0) is the number of worker threads
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::vector<gzip::BufferView> tiles(10000, gzip::BufferView{tile.data(), tile.size()});
+    gzip::BatchCompressor comp(Z_DEFAULT_COMPRESSION, static_cast<std::size_t>(state.range(0)));
+    gzip::BatchOutput output;
+
+    for (auto _ : state)
+    {
+        comp.compress(output, tiles);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(tiles.size()));
+}
+
+BENCHMARK(BM_compress_batch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_compress_batch_baseline(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // Baseline for BM_compress_batch: one std::string per tile from gzip::compress
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::vector<std::string> outputs(10000);
+
+    for (auto _ : state)
+    {
+        for (auto& output : outputs)
+        {
+            output = gzip::compress(tile.data(), tile.size());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(outputs.size()));
+}
+
+BENCHMARK(BM_compress_batch_baseline)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_decompress_batch(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // 1000 compressed tiles in one batch, range(0) is the number of worker threads
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::string compressed = gzip::compress(tile.data(), tile.size());
+    std::vector<gzip::BufferView> tiles(1000, gzip::BufferView{compressed.data(), compressed.size()});
+    gzip::BatchDecompressor decomp(static_cast<std::size_t>(state.range(0)));
+    gzip::BatchOutput output;
+
+    for (auto _ : state)
+    {
+        decomp.decompress(output, tiles);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(tiles.size()));
+}
+
+BENCHMARK(BM_decompress_batch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_decompress_batch_baseline(benchmark::State& state) // NOLINT google-runtime-references
+{
+    // Baseline for BM_decompress_batch: one std::string and inflateInit2 per tile from gzip::decompress
+    std::string tile = open_file("./bench/14-4685-6265.mvt");
+    std::string compressed = gzip::compress(tile.data(), tile.size());
+    std::vector<std::string> outputs(1000);
+
+    for (auto _ : state)
+    {
+        for (auto& output : outputs)
+        {
+            output = gzip::decompress(compressed.data(), compressed.size());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(outputs.size()));
+}
+
+BENCHMARK(BM_decompress_batch_baseline)->UseRealTime()->Unit(benchmark::kMillisecond);
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic"
 BENCHMARK_MAIN();
@@ -0,0 +1,311 @@
+#ifndef GZIP_ALLOCATOR_HPP_INCLUDED
+#define GZIP_ALLOCATOR_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace gzip {
+
+	// Supplies the memory zlib allocates for a stream's internal state (the deflate hash
+	// chains and window, the inflate window). Pass one to Compressor or Decompressor to
+	// replace malloc for that instance; it must outlive every stream created from it.
+	// allocate is called from inside zlib and must return nullptr rather than throw.
+	class Allocator {
+	  public:
+		virtual ~Allocator() {}
+
+		virtual void* allocate(std::size_t size) = 0;
+		virtual void deallocate(void* pointer) = 0;
+	};
+
+	namespace detail {
+
+		// every block handed to zlib is aligned like malloc would align it
+		constexpr std::size_t allocation_alignment = alignof(std::max_align_t);
+
+		inline std::size_t align_allocation(std::size_t size) {
+			return (size + allocation_alignment - 1) / allocation_alignment * allocation_alignment;
+		}
+
+		inline voidpf allocator_alloc(voidpf opaque, uInt items, uInt size) {
+			try {
+				return static_cast<Allocator*>(opaque)->allocate(static_cast<std::size_t>(items) * size);
+			} catch (...) {
+				return Z_NULL;
+			}
+		}
+
+		inline void allocator_free(voidpf opaque, voidpf address) {
+			static_cast<Allocator*>(opaque)->deallocate(address);
+		}
+
+		// Routes the allocations of a stream through allocator, or malloc when it is null.
+		// Must be called before deflateInit2/inflateInit2.
+		inline void set_allocator(z_stream& stream, Allocator* allocator) {
+			stream.zalloc = allocator ? allocator_alloc : Z_NULL;
+			stream.zfree = allocator ? allocator_free : Z_NULL;
+			stream.opaque = allocator;
+		}
+
+		// Lists the sizes of the blocks deflateInit2 allocates for these parameters, which
+		// depend on the zlib version, so they are measured rather than computed
+		inline std::vector<std::size_t> deflate_allocation_sizes(int window_bits, int mem_level) {
+			struct Recorder : Allocator {
+				std::vector<std::size_t> sizes;
+				void* allocate(std::size_t size) override {
+					sizes.push_back(size);
+					return ::operator new(size, std::nothrow);
+				}
+				void deallocate(void* pointer) override {
+					::operator delete(pointer);
+				}
+			} recorder;
+			z_stream stream;
+			set_allocator(stream, &recorder);
+			stream.avail_in = 0;
+			stream.next_in = Z_NULL;
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wold-style-cast"
+			if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+				throw std::runtime_error("deflate init failed");
+			}
+	#pragma GCC diagnostic pop
+			deflateEnd(&stream);
+			return recorder.sizes;
+		}
+
+		// Keeps every block it hands out and gives it back to the next request of the same
+		// size, for a stream that is ended and created again with the same parameters. New
+		// blocks come from upstream when one is given, otherwise from operator new.
+		class BlockCache : public Allocator {
+			struct Block {
+				void* pointer;
+				std::size_t size;
+				bool used;
+			};
+
+			Allocator* upstream_;
+			std::vector<Block> blocks_;
+
+		  public:
+			explicit BlockCache(Allocator* upstream = nullptr) : upstream_(upstream) {}
+
+			~BlockCache() {
+				for (auto const& block : blocks_) {
+					if (upstream_) {
+						upstream_->deallocate(block.pointer);
+					} else {
+						::operator delete(block.pointer);
+					}
+				}
+			}
+
+			BlockCache(const BlockCache&) = delete;
+			BlockCache& operator=(const BlockCache&) = delete;
+
+			void* allocate(std::size_t size) override {
+				for (auto& block : blocks_) {
+					if (!block.used && block.size == size) {
+						block.used = true;
+						return block.pointer;
+					}
+				}
+				void* pointer = upstream_ ? upstream_->allocate(size) : ::operator new(size, std::nothrow);
+				if (pointer) {
+					blocks_.push_back(Block{pointer, size, true});
+				}
+				return pointer;
+			}
+
+			void deallocate(void* pointer) override {
+				for (auto& block : blocks_) {
+					if (block.pointer == pointer) {
+						block.used = false;
+						return;
+					}
+				}
+			}
+		};
+
+	} // namespace detail
+
+	// A bump allocator for short lived streams. Allocations are carved one after the other
+	// out of a single block and deallocation only counts; once every stream using the arena
+	// has been released (e.g. after a one-shot compress call) it rewinds to the start. Blocks
+	// that did not fit are served by operator new and the arena grows to hold them all next
+	// time, so after the first round a stream costs no heap allocation at all.
+	// Not thread safe: use one arena per thread or per instance.
+	class ArenaAllocator : public Allocator {
+		char* block_;
+		std::size_t capacity_;
+		std::size_t used_;
+		std::size_t live_;
+		std::size_t overflow_size_;
+		std::vector<void*> overflow_;
+
+		void rewind() {
+			for (void* pointer : overflow_) {
+				::operator delete(pointer);
+			}
+			overflow_.clear();
+			if (overflow_size_ > 0) {
+				std::size_t capacity = used_ + overflow_size_;
+				::operator delete(block_);
+				block_ = static_cast<char*>(::operator new(capacity));
+				capacity_ = capacity;
+			}
+			used_ = 0;
+			overflow_size_ = 0;
+		}
+
+	  public:
+		// capacity = 0 learns the size from the first round of allocations
+		explicit ArenaAllocator(std::size_t capacity = 0) :
+			block_(static_cast<char*>(::operator new(detail::align_allocation(capacity)))),
+			capacity_(detail::align_allocation(capacity)),
+			used_(0),
+			live_(0),
+			overflow_size_(0) {
+		}
+
+		~ArenaAllocator() {
+			rewind();
+			::operator delete(block_);
+		}
+
+		ArenaAllocator(const ArenaAllocator&) = delete;
+		ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+		void* allocate(std::size_t size) override {
+			size = detail::align_allocation(size);
+			void* pointer = nullptr;
+			if (capacity_ - used_ >= size) {
+				pointer = block_ + used_;
+				used_ += size;
+			} else {
+				pointer = ::operator new(size, std::nothrow);
+				if (!pointer) {
+					return nullptr;
+				}
+				overflow_.push_back(pointer);
+				overflow_size_ += size;
+			}
+			++live_;
+			return pointer;
+		}
+
+		void deallocate(void*) override {
+			if (--live_ == 0) {
+				rewind();
+			}
+		}
+
+		// Drops every allocation at once; only valid when no stream uses the arena anymore
+		void reset() {
+			live_ = 0;
+			rewind();
+		}
+
+		std::size_t capacity() const { return capacity_; }
+		std::size_t used() const { return used_ + overflow_size_; }
+	};
+
+	// A fixed size slab pool for deflate streams. The constructor measures the blocks one
+	// deflate stream allocates for the given window bits and mem level and preallocates
+	// exactly that for `streams` concurrent streams, one slab per block size with a free list
+	// each. Requests of any other size, or beyond the preallocated count, fall back to
+	// operator new. Thread safe: the free lists are guarded by a mutex held for a pop or a
+	// push only, so workers sharing a pool never reach malloc once the pool is warm.
+	class SlabPool : public Allocator {
+		struct Slab {
+			std::size_t size;
+			char* begin;
+			char* end;
+			std::vector<void*> free;
+		};
+
+		std::vector<Slab> slabs_;
+		std::mutex mutex_;
+		std::size_t misses_;
+
+	  public:
+		explicit SlabPool(std::size_t streams, int window_bits = 15, int mem_level = 8) : misses_(0) {
+			std::vector<std::size_t> sizes = detail::deflate_allocation_sizes(window_bits, mem_level);
+			for (std::size_t& size : sizes) {
+				size = detail::align_allocation(size);
+			}
+			std::sort(sizes.begin(), sizes.end());
+			for (std::size_t i = 0; i < sizes.size();) {
+				std::size_t count = static_cast<std::size_t>(std::upper_bound(sizes.begin() + static_cast<std::ptrdiff_t>(i), sizes.end(), sizes[i]) - sizes.begin()) - i;
+				std::size_t blocks = count * streams;
+				Slab slab = {sizes[i], nullptr, nullptr, std::vector<void*>()};
+				slab.begin = static_cast<char*>(::operator new(blocks * sizes[i]));
+				slab.end = slab.begin + blocks * sizes[i];
+				slab.free.reserve(blocks);
+				// hand out the lowest addresses first
+				for (std::size_t block = blocks; block > 0; --block) {
+					slab.free.push_back(slab.begin + (block - 1) * sizes[i]);
+				}
+				slabs_.push_back(std::move(slab));
+				i += count;
+			}
+		}
+
+		~SlabPool() {
+			for (auto& slab : slabs_) {
+				::operator delete(slab.begin);
+			}
+		}
+
+		SlabPool(const SlabPool&) = delete;
+		SlabPool& operator=(const SlabPool&) = delete;
+
+		void* allocate(std::size_t size) override {
+			size = detail::align_allocation(size);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (auto& slab : slabs_) {
+					if (slab.size == size && !slab.free.empty()) {
+						void* pointer = slab.free.back();
+						slab.free.pop_back();
+						return pointer;
+					}
+				}
+				++misses_;
+			}
+			return ::operator new(size, std::nothrow);
+		}
+
+		void deallocate(void* pointer) override {
+			char* address = static_cast<char*>(pointer);
+			for (auto& slab : slabs_) {
+				if (!std::less<char*>()(address, slab.begin) && std::less<char*>()(address, slab.end)) {
+					std::lock_guard<std::mutex> lock(mutex_);
+					slab.free.push_back(pointer);
+					return;
+				}
+			}
+			::operator delete(pointer);
+		}
+
+		// Number of allocations that were not served from the slabs
+		std::size_t misses() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return misses_;
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef GZIP_BATCH_HPP_INCLUDED
+#define GZIP_BATCH_HPP_INCLUDED
+
+#include <gzip/compress.hpp>
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/parallel.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	// A non-owning (pointer, size) view of one buffer
+	struct BufferView {
+		const char* data;
+		std::size_t size;
+	};
+
+	// The results of a batch call: every output lives back to back in one arena and is
+	// reached through offsets, so a batch costs no per-item allocation. Reusing the same
+	// BatchOutput across calls keeps the arena capacity, after which calls allocate nothing.
+	class BatchOutput {
+		std::string arena_;
+		std::vector<std::size_t> offsets_;
+
+		friend class BatchCompressor;
+		friend class BatchDecompressor;
+
+	  public:
+		BatchOutput() : offsets_(1, 0) {}
+
+		std::size_t size() const { return offsets_.size() - 1; }
+
+		BufferView operator[](std::size_t index) const {
+			return BufferView{arena_.data() + offsets_[index], offsets_[index + 1] - offsets_[index]};
+		}
+
+		// All outputs concatenated, e.g. to write them out with a single call
+		std::string const& arena() const { return arena_; }
+	};
+
+	// Compresses many independent small buffers (tiles, messages) into separate gzip members.
+	// Items are spread over worker threads; each worker keeps one deflate stream that is only
+	// reset between items and across calls. Every item is given its deflateBound sized slot in
+	// the arena, so workers write in place without locking, and the slots are then packed
+	// together in one pass.
+	class BatchCompressor {
+		std::size_t max_;
+		int level_;
+		std::size_t threads_;
+		Executor* executor_;
+		std::vector<detail::DeflateStreamPtr> streams_;
+		std::vector<std::size_t> bounds_;
+
+		z_stream& stream(std::size_t worker) {
+			if (streams_[worker]) {
+				deflateReset(streams_[worker].get());
+			} else {
+				streams_[worker] = detail::make_deflate_stream(level_);
+			}
+			return *streams_[worker];
+		}
+
+	  public:
+		BatchCompressor(int level = Z_DEFAULT_COMPRESSION,
+						std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+						std::size_t max_bytes = 2000000000, // by default refuse operation if an uncompressed item is > 2GB
+						Executor* executor = nullptr) :
+			max_(max_bytes),
+			level_(level),
+			threads_(threads),
+			executor_(executor) {
+		}
+
+		BatchCompressor(BatchCompressor&&) = default;
+		BatchCompressor& operator=(BatchCompressor&&) = default;
+		BatchCompressor(const BatchCompressor&) = delete;
+		BatchCompressor& operator=(const BatchCompressor&) = delete;
+
+		void compress(BatchOutput& output,
+					  const BufferView* inputs,
+					  std::size_t count)
+		{
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			if (streams_.size() < workers) {
+				streams_.resize(workers);
+			}
+
+			// slot layout: the offsets first hold where each item may start writing
+			z_stream& first = stream(0);
+			output.offsets_.resize(count + 1);
+			bounds_.resize(count);
+			std::size_t total = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				if (inputs[index].size > max_ || inputs[index].size > std::numeric_limits<unsigned int>::max()) {
+					throw std::runtime_error("size may use more memory than intended when decompressing");
+				}
+				output.offsets_[index] = total;
+				bounds_[index] = deflateBound(&first, static_cast<uLong>(inputs[index].size));
+				total += bounds_[index];
+			}
+			if (output.arena_.size() < total) {
+				output.arena_.resize(total);
+			}
+			char* arena = count > 0 ? &output.arena_[0] : nullptr;
+
+			detail::parallel_for(count, workers, [&](std::size_t worker, std::size_t index) {
+				z_stream& deflate_s = stream(worker);
+				deflate_s.next_in = reinterpret_cast<z_const Bytef*>(inputs[index].data);
+				deflate_s.avail_in = static_cast<unsigned int>(inputs[index].size);
+				deflate_s.next_out = reinterpret_cast<Bytef*>(arena + output.offsets_[index]);
+				deflate_s.avail_out = static_cast<unsigned int>(bounds_[index]);
+				// the slot holds deflateBound bytes, so a single Z_FINISH call always completes
+				if (deflate(&deflate_s, Z_FINISH) != Z_STREAM_END) {
+					throw std::runtime_error("deflate failed");
+				}
+				bounds_[index] -= deflate_s.avail_out;
+			}, executor_);
+
+			// pack the slots; every item only moves towards the front
+			std::size_t packed = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				if (packed != output.offsets_[index]) {
+					std::memmove(arena + packed, arena + output.offsets_[index], bounds_[index]);
+				}
+				output.offsets_[index] = packed;
+				packed += bounds_[index];
+			}
+			output.offsets_[count] = packed;
+			output.arena_.resize(packed);
+		}
+
+		void compress(BatchOutput& output, std::vector<BufferView> const& inputs) {
+			compress(output, inputs.data(), inputs.size());
+		}
+	};
+
+	// The read side of BatchCompressor: decompresses many independent gzip or zlib buffers into
+	// one arena. The ISIZE trailer of each gzip item, when plausible, sizes its slot up front, so workers inflate
+	// straight into the arena with one inflate stream each that is reused across items and calls.
+	// Items where ISIZE can not be trusted (zlib framing, several members, corrupt trailers) are
+	// decoded again by a per worker Decompressor and the arena is rebuilt once at the end.
+	class BatchDecompressor {
+		std::size_t max_;
+		std::size_t threads_;
+		Executor* executor_;
+		std::vector<detail::InflateStreamPtr> streams_;
+		std::vector<Decompressor> fallbacks_;
+		std::vector<std::size_t> produced_;
+		std::vector<std::string> spills_;
+
+		z_stream& stream(std::size_t worker) {
+			if (streams_[worker]) {
+				inflateReset2(streams_[worker].get(), detail::inflate_window_bits);
+			} else {
+				streams_[worker] = detail::make_inflate_stream();
+			}
+			return *streams_[worker];
+		}
+
+		// Inflates one item into its slot, returns false unless it is a single member filling the slot exactly
+		bool inflate_slot(z_stream& inflate_s, BufferView const& input, char* slot, std::size_t slot_size) const {
+			// zlib needs somewhere to point next_out even when the item is empty
+			char empty = 0;
+			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(input.data);
+			inflate_s.avail_in = static_cast<unsigned int>(input.size);
+			inflate_s.next_out = reinterpret_cast<Bytef*>(slot_size > 0 ? slot : &empty);
+			inflate_s.avail_out = static_cast<unsigned int>(slot_size);
+			int ret = inflate(&inflate_s, Z_FINISH);
+			if (ret != Z_STREAM_END || inflate_s.avail_out != 0) {
+				return false;
+			}
+			return !detail::is_gzip_member(input.data + input.size - inflate_s.avail_in, inflate_s.avail_in);
+		}
+
+	  public:
+		BatchDecompressor(std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+						  std::size_t max_bytes = 1000000000, // by default refuse operation if an item is > 1GB
+						  Executor* executor = nullptr) :
+			max_(max_bytes),
+			threads_(threads),
+			executor_(executor) {
+		}
+
+		BatchDecompressor(BatchDecompressor&&) = default;
+		BatchDecompressor& operator=(BatchDecompressor&&) = default;
+		BatchDecompressor(const BatchDecompressor&) = delete;
+		BatchDecompressor& operator=(const BatchDecompressor&) = delete;
+
+		void decompress(BatchOutput& output,
+						const BufferView* inputs,
+						std::size_t count)
+		{
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			if (streams_.size() < workers) {
+				streams_.resize(workers);
+			}
+			while (fallbacks_.size() < workers) {
+				fallbacks_.emplace_back(max_);
+			}
+
+			// slot layout: the offsets first hold where each item may start writing
+			output.offsets_.resize(count + 1);
+			produced_.resize(count);
+			spills_.resize(count);
+			// ISIZE is untrusted input, so it is only a hint: capped at what the item can decode
+			// to, and the slots reserved from hints together stay within max_bytes. Items left
+			// without a slot go to the fallback, whose output grows as it is produced.
+			std::size_t total = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				if (inputs[index].size > max_ || (inputs[index].size * 2) > max_) {
+					throw std::runtime_error("size may use more memory than intended when decompressing");
+				}
+				std::uint32_t isize = 0;
+				if (!read_isize(inputs[index].data, inputs[index].size, isize) ||
+					isize > max_ - total ||
+					isize / detail::max_inflate_ratio > inputs[index].size) {
+					isize = 0;
+				}
+				output.offsets_[index] = total;
+				produced_[index] = isize;
+				total += isize;
+			}
+			if (output.arena_.size() < total) {
+				output.arena_.resize(total);
+			}
+			char* arena = total > 0 ? &output.arena_[0] : nullptr;
+
+			detail::parallel_for(count, workers, [&](std::size_t worker, std::size_t index) {
+				if (!inflate_slot(stream(worker), inputs[index], arena + output.offsets_[index], produced_[index])) {
+					fallbacks_[worker].decompress(spills_[index], inputs[index].data, inputs[index].size);
+					produced_[index] = std::numeric_limits<std::size_t>::max();
+				}
+			}, executor_);
+			bool spilled = std::find(produced_.begin(), produced_.end(), std::numeric_limits<std::size_t>::max()) != produced_.end();
+
+			if (!spilled) {
+				// every slot was filled exactly, so the arena is already packed
+				output.offsets_[count] = total;
+				output.arena_.resize(total);
+				return;
+			}
+			std::string arena_out;
+			std::size_t packed = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				packed += produced_[index] == std::numeric_limits<std::size_t>::max() ? spills_[index].size() : produced_[index];
+			}
+			arena_out.resize(packed);
+			packed = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				bool spill = produced_[index] == std::numeric_limits<std::size_t>::max();
+				std::size_t size = spill ? spills_[index].size() : produced_[index];
+				if (size > 0) {
+					std::memcpy(&arena_out[packed], spill ? spills_[index].data() : arena + output.offsets_[index], size);
+				}
+				if (spill) {
+					std::string().swap(spills_[index]);
+				}
+				output.offsets_[index] = packed;
+				packed += size;
+			}
+			output.offsets_[count] = packed;
+			output.arena_.swap(arena_out);
+		}
+
+		void decompress(BatchOutput& output, std::vector<BufferView> const& inputs) {
+			decompress(output, inputs.data(), inputs.size());
+		}
+	};
+
+	inline BatchOutput compress_batch(
+		std::vector<BufferView> const& inputs,
+		int level = Z_DEFAULT_COMPRESSION,
+		std::size_t threads = 0) {
+		BatchCompressor comp(level, threads);
+		BatchOutput output;
+		comp.compress(output, inputs);
+		return output;
+	}
+
+	inline BatchOutput decompress_batch(
+		std::vector<BufferView> const& inputs,
+		std::size_t threads = 0) {
+		BatchDecompressor decomp(threads);
+		BatchOutput output;
+		decomp.decompress(output, inputs);
+		return output;
+	}
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef GZIP_BGZF_HPP_INCLUDED
+#define GZIP_BGZF_HPP_INCLUDED
+
+#include <gzip/compress.hpp>
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/output.hpp>
+#include <gzip/parallel.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	namespace detail {
+
+		// A BGZF block is a gzip member of at most 64Kb whose header carries a 'BC' extra
+		// subfield holding the total block size minus one
+		constexpr std::size_t bgzf_header_size = 18;
+		constexpr std::size_t bgzf_max_block_size = 65536;
+		// input per block that keeps even incompressible data under bgzf_max_block_size
+		constexpr std::size_t bgzf_max_input_size = 65280;
+
+		// the empty block that marks the end of a BGZF file
+		constexpr char bgzf_eof[28] = {'\x1F', '\x8B', '\x08', '\x04', 0, 0, 0, 0, 0, '\xFF', '\x06', 0, 'B', 'C', '\x02', 0,
+									   '\x1B', 0, '\x03', 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+		// Size of the BGZF block starting at data, or 0 if it is not one
+		inline std::size_t bgzf_block_size(const char* data, std::size_t size) {
+			if (size < bgzf_header_size + gzip_trailer_size || !is_gzip_member(data, size) ||
+				data[2] != Z_DEFLATED || (static_cast<std::uint8_t>(data[3]) & 4) == 0) {
+				return 0;
+			}
+			std::size_t xlen = static_cast<std::uint8_t>(data[10]) | static_cast<std::size_t>(static_cast<std::uint8_t>(data[11])) << 8;
+			if (12 + xlen > size) {
+				return 0;
+			}
+			for (std::size_t at = 12; at + 4 <= 12 + xlen;) {
+				std::size_t slen = static_cast<std::uint8_t>(data[at + 2]) | static_cast<std::size_t>(static_cast<std::uint8_t>(data[at + 3])) << 8;
+				if (data[at] == 'B' && data[at + 1] == 'C' && slen == 2 && at + 6 <= 12 + xlen) {
+					std::size_t block = (static_cast<std::uint8_t>(data[at + 4]) | static_cast<std::size_t>(static_cast<std::uint8_t>(data[at + 5])) << 8) + 1;
+					return block <= size && block >= 12 + xlen + gzip_trailer_size ? block : 0;
+				}
+				at += 4 + slen;
+			}
+			return 0;
+		}
+
+	} // namespace detail
+
+	// Builds a BGZF virtual offset: the file offset of a block in the upper 48 bits and
+	// the offset inside its uncompressed data in the lower 16 bits
+	inline std::uint64_t bgzf_virtual_offset(std::uint64_t compressed_offset, std::uint16_t within_block) {
+		return compressed_offset << 16 | within_block;
+	}
+
+	// Writes BGZF (blocked gzip, as used by samtools/htslib): the input is cut into 65280
+	// byte pieces, each compressed concurrently into its own gzip member of at most 64Kb
+	// with the block size stored in a 'BC' extra field, followed by the standard empty
+	// EOF block. The output is ordinary multi-member gzip that gzip::decompress reads.
+	class BgzfCompressor {
+		std::size_t max_;
+		int level_;
+		std::size_t threads_;
+		Executor* executor_;
+
+		void compress_block(z_stream& deflate_s,
+							std::string& block,
+							const char* data,
+							std::size_t size) const {
+			deflateReset(&deflate_s);
+			block.resize(detail::bgzf_header_size + deflateBound(&deflate_s, static_cast<uLong>(size)) + detail::gzip_trailer_size);
+			deflate_s.next_in = reinterpret_cast<z_const Bytef*>(data);
+			deflate_s.avail_in = static_cast<unsigned int>(size);
+			deflate_s.next_out = reinterpret_cast<Bytef*>(&block[detail::bgzf_header_size]);
+			deflate_s.avail_out = static_cast<unsigned int>(block.size() - detail::bgzf_header_size - detail::gzip_trailer_size);
+			if (deflate(&deflate_s, Z_FINISH) != Z_STREAM_END) {
+				throw std::runtime_error("deflate failed");
+			}
+			std::size_t total = block.size() - deflate_s.avail_out;
+			if (total > detail::bgzf_max_block_size) {
+				throw std::runtime_error("bgzf block does not fit into 64Kb");
+			}
+			block.resize(total);
+
+			const char header[detail::bgzf_header_size] = {'\x1F', '\x8B', Z_DEFLATED, 4, 0, 0, 0, 0, 0, '\xFF', 6, 0, 'B', 'C', 2, 0,
+														   static_cast<char>((total - 1) & 0xFF), static_cast<char>((total - 1) >> 8)};
+			std::memcpy(&block[0], header, detail::bgzf_header_size);
+			uLong crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data), static_cast<unsigned int>(size));
+			detail::put_le32(&block[total - 8], static_cast<std::uint32_t>(crc));
+			detail::put_le32(&block[total - 4], static_cast<std::uint32_t>(size));
+		}
+
+	  public:
+		BgzfCompressor(int level = Z_DEFAULT_COMPRESSION,
+					   std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+					   std::size_t max_bytes = 2000000000, // by default refuse operation if uncompressed data is > 2GB
+					   Executor* executor = nullptr) :
+			max_(max_bytes),
+			level_(level),
+			threads_(threads),
+			executor_(executor) {
+		}
+
+		template <typename OutputType>
+		void compress(OutputType& output,
+					  const char* data,
+					  std::size_t size) const
+		{
+			if (size > max_) {
+				throw std::runtime_error("size may use more memory than intended when decompressing");
+			}
+
+			std::size_t count = (size + detail::bgzf_max_input_size - 1) / detail::bgzf_max_input_size;
+			std::vector<std::string> blocks(count);
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			detail::parallel_for(count, workers, [&](std::size_t, std::size_t index) {
+				std::size_t begin = index * detail::bgzf_max_input_size;
+				compress_block(detail::local_deflate_stream(level_, -15), blocks[index], data + begin, std::min(detail::bgzf_max_input_size, size - begin));
+			}, executor_);
+
+			std::size_t total = sizeof(detail::bgzf_eof);
+			for (auto const& block : blocks) {
+				total += block.size();
+			}
+			OutputTraits<OutputType>::resize(output, total);
+			char* out = OutputTraits<OutputType>::data(output);
+			for (auto const& block : blocks) {
+				std::memcpy(out, block.data(), block.size());
+				out += block.size();
+			}
+			std::memcpy(out, detail::bgzf_eof, sizeof(detail::bgzf_eof));
+		}
+	};
+
+	// Random access and parallel decompression of BGZF data. The constructor walks the block
+	// headers once (each holds the size of its block, so only headers and trailers are read)
+	// to build the table of blocks; reads then decode just the blocks they need, concurrently.
+	// The data must outlive the reader.
+	class BgzfReader {
+		const char* data_;
+		std::size_t max_;
+		std::size_t threads_;
+		Executor* executor_;
+		std::vector<Member> blocks_;
+
+		// Decompresses blocks [first, last) into out, which holds their uncompressed sizes
+		void inflate_blocks(char* out, std::size_t first, std::size_t last) const {
+			std::size_t base = blocks_[first].uncompressed_offset;
+			std::size_t workers = detail::worker_count(threads_, last - first, executor_);
+			detail::parallel_for(last - first, workers, [&](std::size_t, std::size_t index) {
+				Member const& block = blocks_[first + index];
+				if (block.uncompressed_size == 0) {
+					return;
+				}
+				z_stream& inflate_s = detail::local_inflate_stream(15 + 16);
+				inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data_ + block.compressed_offset);
+				inflate_s.avail_in = static_cast<unsigned int>(block.compressed_size);
+				inflate_s.next_out = reinterpret_cast<Bytef*>(out + block.uncompressed_offset - base);
+				inflate_s.avail_out = static_cast<unsigned int>(block.uncompressed_size);
+				int ret = inflate(&inflate_s, Z_FINISH);
+				if (ret != Z_STREAM_END || inflate_s.avail_out != 0) {
+					throw std::runtime_error(inflate_s.msg != Z_NULL ? inflate_s.msg : "invalid bgzf block");
+				}
+			}, executor_);
+		}
+
+	  public:
+		BgzfReader(const char* data,
+				   std::size_t size,
+				   std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+				   std::size_t max_bytes = 1000000000, // by default refuse operation if uncompressed data is > 1GB
+				   Executor* executor = nullptr) :
+			data_(data),
+			max_(max_bytes),
+			threads_(threads),
+			executor_(executor) {
+			std::size_t uncompressed = 0;
+			for (std::size_t at = 0; at < size;) {
+				std::size_t block = detail::bgzf_block_size(data + at, size - at);
+				if (block == 0) {
+					throw std::runtime_error("invalid bgzf block");
+				}
+				std::size_t length = detail::get_le32(data + at + block - 4);
+				if (length > detail::bgzf_max_block_size) {
+					throw std::runtime_error("invalid bgzf block");
+				}
+				Member member = {at, block, uncompressed, length};
+				blocks_.push_back(member);
+				uncompressed += length;
+				at += block;
+			}
+		}
+
+		std::vector<Member> const& blocks() const { return blocks_; }
+
+		std::size_t uncompressed_size() const {
+			return blocks_.empty() ? 0 : blocks_.back().uncompressed_offset + blocks_.back().uncompressed_size;
+		}
+
+		// Virtual offset of a position in the uncompressed data
+		std::uint64_t virtual_offset(std::size_t uncompressed_offset) const {
+			if (blocks_.empty() || uncompressed_offset > uncompressed_size()) {
+				throw std::runtime_error("offset is past the end of the bgzf data");
+			}
+			auto it = std::upper_bound(blocks_.begin(), blocks_.end(), uncompressed_offset,
+									   [](std::size_t value, Member const& block) {
+										   return value < block.uncompressed_offset;
+									   });
+			Member const& block = *(it - 1);
+			return bgzf_virtual_offset(block.compressed_offset, static_cast<std::uint16_t>(uncompressed_offset - block.uncompressed_offset));
+		}
+
+		// Decompresses all blocks into output
+		template <typename OutputType>
+		void decompress(OutputType& output) const {
+			if (uncompressed_size() > max_) {
+				throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+			}
+			OutputTraits<OutputType>::resize(output, uncompressed_size());
+			if (!blocks_.empty() && uncompressed_size() > 0) {
+				inflate_blocks(OutputTraits<OutputType>::data(output), 0, blocks_.size());
+			}
+		}
+
+		// Decompresses up to length bytes starting at a virtual offset, clipped to the end of the data
+		template <typename OutputType>
+		void read(OutputType& output,
+				  std::uint64_t virtual_offset,
+				  std::size_t length) const {
+			std::uint64_t compressed_offset = virtual_offset >> 16;
+			std::size_t within = static_cast<std::size_t>(virtual_offset & 0xFFFF);
+			auto first = std::lower_bound(blocks_.begin(), blocks_.end(), compressed_offset,
+										  [](Member const& block, std::uint64_t value) {
+											  return block.compressed_offset < value;
+										  });
+			if (first == blocks_.end() || first->compressed_offset != compressed_offset || within > first->uncompressed_size) {
+				throw std::runtime_error("invalid bgzf virtual offset");
+			}
+			std::size_t begin = first->uncompressed_offset + within;
+			length = std::min(length, uncompressed_size() - begin);
+			if (length > max_) {
+				throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+			}
+			if (length == 0) {
+				OutputTraits<OutputType>::resize(output, 0);
+				return;
+			}
+			auto last = std::lower_bound(first, blocks_.end(), begin + length,
+										 [](Member const& block, std::size_t value) {
+											 return block.uncompressed_offset < value;
+										 });
+			// decode whole blocks, then drop the bytes in front of the offset
+			std::size_t decoded = (last - 1)->uncompressed_offset + (last - 1)->uncompressed_size - first->uncompressed_offset;
+			OutputTraits<OutputType>::resize(output, decoded);
+			char* out = OutputTraits<OutputType>::data(output);
+			inflate_blocks(out, static_cast<std::size_t>(first - blocks_.begin()), static_cast<std::size_t>(last - blocks_.begin()));
+			if (within > 0) {
+				std::memmove(out, out + within, length);
+			}
+			OutputTraits<OutputType>::resize(output, length);
+		}
+	};
+
+	inline std::string compress_bgzf(
+		const char* data,
+		std::size_t size,
+		int level = Z_DEFAULT_COMPRESSION,
+		std::size_t threads = 0) {
+		BgzfCompressor comp(level, threads);
+		std::string output;
+		comp.compress(output, data, size);
+		return output;
+	}
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef GZIP_BUFFER_HPP_INCLUDED
+#define GZIP_BUFFER_HPP_INCLUDED
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
+
+namespace gzip {
+
+	// A (pointer, length) run of bytes, the parts of a ChunkedBuffer or the fragments of
+	// input compressed as one. On POSIX systems this is struct iovec, so segments can be
+	// passed to writev and readv as they are.
+#if defined(__unix__) || defined(__APPLE__)
+	using Segment = ::iovec;
+#else
+	struct Segment {
+		void* iov_base;
+		std::size_t iov_len;
+	};
+#endif
+
+	// A byte buffer whose resize leaves new bytes uninitialized. std::string::resize writes
+	// zeros over every byte it adds, only for zlib to overwrite them right away: an extra
+	// pass over memory that shows on large outputs. Buffer can stand in for std::string as
+	// the output of Compressor::compress and Decompressor::decompress. Storage comes from
+	// malloc and grows with realloc, which can move large blocks without copying them.
+	class Buffer {
+		char* data_;
+		std::size_t size_;
+		std::size_t capacity_;
+
+	  public:
+		using value_type = char;
+
+		Buffer() : data_(nullptr), size_(0), capacity_(0) {}
+
+		explicit Buffer(std::size_t size) : Buffer() {
+			resize(size);
+		}
+
+		Buffer(Buffer&& other) noexcept : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+			other.data_ = nullptr;
+			other.size_ = 0;
+			other.capacity_ = 0;
+		}
+
+		Buffer& operator=(Buffer&& other) noexcept {
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			std::swap(capacity_, other.capacity_);
+			return *this;
+		}
+
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+
+		~Buffer() {
+			std::free(data_);
+		}
+
+		// Bytes past the old size are left uninitialized. Growing at least doubles the
+		// capacity so that repeated small resizes stay amortized constant.
+		void resize(std::size_t size) {
+			if (size > capacity_) {
+				reserve(std::max(size, 2 * capacity_));
+			}
+			size_ = size;
+		}
+
+		void reserve(std::size_t capacity) {
+			if (capacity <= capacity_) {
+				return;
+			}
+			void* data = std::realloc(data_, capacity);
+			if (data == nullptr) {
+				throw std::bad_alloc();
+			}
+			data_ = static_cast<char*>(data);
+			capacity_ = capacity;
+		}
+
+		void clear() { size_ = 0; }
+
+		char* data() { return data_; }
+		const char* data() const { return data_; }
+		std::size_t size() const { return size_; }
+		std::size_t capacity() const { return capacity_; }
+		bool empty() const { return size_ == 0; }
+
+		char& operator[](std::size_t pos) { return data_[pos]; }
+		const char& operator[](std::size_t pos) const { return data_[pos]; }
+
+		char* begin() { return data_; }
+		char* end() { return data_ + size_; }
+		const char* begin() const { return data_; }
+		const char* end() const { return data_ + size_; }
+
+		std::string str() const { return std::string(data_, size_); }
+	};
+
+	// Outcome of compressing or decompressing into caller provided memory
+	struct WriteResult {
+		std::size_t size;        // bytes written
+		bool insufficient_space; // the output did not fit, the bytes written are unspecified
+	};
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef GZIP_CHUNKED_BUFFER_HPP_INCLUDED
+#define GZIP_CHUNKED_BUFFER_HPP_INCLUDED
+
+#include <gzip/buffer.hpp>
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gzip {
+
+	namespace detail {
+
+		inline std::size_t checked_chunk_size(std::size_t chunk_size) {
+			if (chunk_size == 0) {
+				throw std::runtime_error("chunk size must not be 0");
+			}
+			return chunk_size;
+		}
+
+	} // namespace detail
+
+	// Keeps released chunks of a fixed size for reuse, so buffers filled over and over
+	// stop allocating once the pool holds enough chunks. Safe to share between threads.
+	class ChunkPool {
+		std::size_t chunk_size_;
+		std::vector<char*> free_;
+		std::mutex mutex_;
+
+	  public:
+		explicit ChunkPool(std::size_t chunk_size = 1024 * 1024) : chunk_size_(detail::checked_chunk_size(chunk_size)) {}
+
+		~ChunkPool() {
+			for (char* chunk : free_) {
+				::operator delete(chunk);
+			}
+		}
+
+		ChunkPool(const ChunkPool&) = delete;
+		ChunkPool& operator=(const ChunkPool&) = delete;
+
+		char* acquire() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (!free_.empty()) {
+					char* chunk = free_.back();
+					free_.pop_back();
+					return chunk;
+				}
+			}
+			return static_cast<char*>(::operator new(chunk_size_));
+		}
+
+		void release(char* chunk) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			free_.push_back(chunk);
+		}
+
+		std::size_t chunk_size() const { return chunk_size_; }
+
+		std::size_t free_chunks() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return free_.size();
+		}
+	};
+
+	// Output made of fixed size chunks. Growing adds a chunk and never moves the bytes
+	// already written, where growing a std::string reallocates and copies all of them,
+	// many times over for outputs of a gigabyte. Decompressor::decompress fills it directly.
+	// Chunks come from a ChunkPool when one is given, which must outlive the buffer, and go
+	// back to it when the buffer is cleared or destroyed.
+	class ChunkedBuffer {
+		std::size_t chunk_size_;
+		ChunkPool* pool_;
+		std::vector<Segment> segments_;
+		std::size_t size_;
+
+		void release(Segment const& segment) {
+			char* chunk = static_cast<char*>(segment.iov_base);
+			if (pool_) {
+				pool_->release(chunk);
+			} else {
+				::operator delete(chunk);
+			}
+		}
+
+	  public:
+		explicit ChunkedBuffer(std::size_t chunk_size = 1024 * 1024) :
+			chunk_size_(detail::checked_chunk_size(chunk_size)), pool_(nullptr), size_(0) {
+		}
+
+		explicit ChunkedBuffer(ChunkPool& pool) :
+			chunk_size_(pool.chunk_size()), pool_(&pool), size_(0) {
+		}
+
+		ChunkedBuffer(ChunkedBuffer&& other) noexcept :
+			chunk_size_(other.chunk_size_), pool_(other.pool_), segments_(std::move(other.segments_)), size_(other.size_) {
+			other.segments_.clear();
+			other.size_ = 0;
+		}
+
+		ChunkedBuffer& operator=(ChunkedBuffer&& other) noexcept {
+			std::swap(chunk_size_, other.chunk_size_);
+			std::swap(pool_, other.pool_);
+			std::swap(segments_, other.segments_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+
+		ChunkedBuffer(const ChunkedBuffer&) = delete;
+		ChunkedBuffer& operator=(const ChunkedBuffer&) = delete;
+
+		~ChunkedBuffer() {
+			clear();
+		}
+
+		// Appends a chunk counted as filled and returns it; give back what was not written with trim
+		char* grow() {
+			char* chunk = pool_ ? pool_->acquire() : static_cast<char*>(::operator new(chunk_size_));
+			segments_.push_back(Segment{chunk, chunk_size_});
+			size_ += chunk_size_;
+			return chunk;
+		}
+
+		// Drops the last unused bytes, releasing chunks left empty
+		void trim(std::size_t unused) {
+			while (unused > 0 && !segments_.empty()) {
+				Segment& last = segments_.back();
+				std::size_t drop = std::min(unused, last.iov_len);
+				last.iov_len -= drop;
+				size_ -= drop;
+				unused -= drop;
+				if (last.iov_len == 0) {
+					release(last);
+					segments_.pop_back();
+				}
+			}
+		}
+
+		void clear() {
+			for (Segment const& segment : segments_) {
+				release(segment);
+			}
+			segments_.clear();
+			size_ = 0;
+		}
+
+		std::size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		std::size_t chunk_size() const { return chunk_size_; }
+
+		// The filled chunks in order, e.g. for writev(fd, segments.data(), segments.size()).
+		// writev takes at most IOV_MAX (usually 1024) segments per call.
+		std::vector<Segment> const& segments() const { return segments_; }
+
+		// Copies the contents to output, which must hold size() bytes
+		void copy_to(char* output) const {
+			for (Segment const& segment : segments_) {
+				std::memcpy(output, segment.iov_base, segment.iov_len);
+				output += segment.iov_len;
+			}
+		}
+
+		std::string str() const {
+			std::string output(size_, '\0');
+			if (size_ > 0) {
+				copy_to(&output[0]);
+			}
+			return output;
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -1,51 +1,45 @@
 #ifndef GZIP_COMPRESS_HPP_INCLUDED
 #define GZIP_COMPRESS_HPP_INCLUDED
 
+#include <gzip/allocator.hpp>
+#include <gzip/buffer.hpp>
 #include <gzip/config.hpp>
+#include <gzip/dictionary.hpp>
+#include <gzip/format.hpp>
+#include <gzip/output.hpp>
 
 // zlib
 #include <zlib.h>
 
 // std
+#include <algorithm>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
 namespace gzip {
 
-	class Compressor {
-		std::size_t max_;
-		int level_;
+	namespace detail {
 
-	  public:
-		Compressor(
-			int level = Z_DEFAULT_COMPRESSION,
-			std::size_t max_bytes = 2000000000) : // by default refuse operation if uncompressed data is > 2GB
-			max_(max_bytes), level_(level) {
-		}
-
-		template <typename InputType>
-		void compress(InputType& output,
-					  const char* data,
-					  std::size_t size) const
-		{
-
-	#ifdef DEBUG
-			// Verify if size input will fit into unsigned int, type used for zlib's avail_in
-			if (size > std::numeric_limits<unsigned int>::max()) {
-				throw std::runtime_error("size arg is too large to fit into unsigned int type");
-			}
-	#endif
-			if (size > max_) {
-				throw std::runtime_error("size may use more memory than intended when decompressing");
+		struct DeflateStreamDeleter {
+			void operator()(z_stream* deflate_s) const {
+				deflateEnd(deflate_s);
+				delete deflate_s;
 			}
+		};
 
-			z_stream deflate_s;
-			deflate_s.zalloc = Z_NULL;
-			deflate_s.zfree = Z_NULL;
-			deflate_s.opaque = Z_NULL;
-			deflate_s.avail_in = 0;
-			deflate_s.next_in = Z_NULL;
+		using DeflateStreamPtr = std::unique_ptr<z_stream, DeflateStreamDeleter>;
+
+		// Allocates and initializes a deflate stream, producing gzip output unless told otherwise.
+		// The z_stream is heap allocated because zlib keeps a back pointer to it in its
+		// internal state, so owners can move without moving the stream itself.
+		// zlib's own state comes from allocator when one is given, otherwise from malloc.
+		inline DeflateStreamPtr make_deflate_stream(int level, int window_bits = 15 + 16, Allocator* allocator = nullptr, int mem_level = 8) {
+			std::unique_ptr<z_stream> deflate_s(new z_stream);
+			set_allocator(*deflate_s, allocator);
+			deflate_s->avail_in = 0;
+			deflate_s->next_in = Z_NULL;
 
 			// The windowBits parameter is the base two logarithm of the window size (the size of the history buffer).
 			// It should be in the range 8..15 for this version of the library.
@@ -55,9 +49,8 @@ namespace gzip {
 			//  8 to 15 for zlib
 			// (8 to 15) + 16 for gzip
 			// (8 to 15) + 32 to automatically detect gzip/zlib header (decompression/inflate only)
-			constexpr int window_bits = 15 + 16; // gzip with windowbits of 15
+			// The default of 15 + 16 is gzip with windowbits of 15
 
-			constexpr int mem_level = 8;
 			// The memory requirements for deflate are (in bytes):
 			// (1 << (window_bits+2)) +  (1 << (mem_level+9))
 			// with a default value of 8 for mem_level and our window_bits of 15
@@ -65,37 +58,282 @@ namespace gzip {
 
 	#pragma GCC diagnostic push
 	#pragma GCC diagnostic ignored "-Wold-style-cast"
-			if (deflateInit2(&deflate_s, level_, Z_DEFLATED, window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+			if (deflateInit2(deflate_s.get(), level, Z_DEFLATED, window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
 				throw std::runtime_error("deflate init failed");
 			}
 	#pragma GCC diagnostic pop
 
+			return DeflateStreamPtr(deflate_s.release());
+		}
+
+		// A reset deflate stream owned by the calling thread. Parallel compressors take their
+		// per worker streams from here, so threads that live on, such as ThreadPool workers,
+		// keep one allocated deflate state across calls instead of paying deflateInit2 each time.
+		inline z_stream& local_deflate_stream(int level, int window_bits) {
+			struct Cached {
+				DeflateStreamPtr stream;
+				int level;
+				int window_bits;
+			};
+			static thread_local Cached cached = {DeflateStreamPtr(), 0, 0};
+			if (cached.stream && cached.level == level && cached.window_bits == window_bits) {
+				deflateReset(cached.stream.get());
+			} else {
+				cached.stream = make_deflate_stream(level, window_bits);
+				cached.level = level;
+				cached.window_bits = window_bits;
+			}
+			return *cached.stream;
+		}
+
+		// A stream primed with a preset dictionary and the stream copied from it for each call.
+		// The cache is declared first so it outlives the blocks both streams allocate from it.
+		struct PrimedDeflateStream {
+			std::unique_ptr<BlockCache> cache;
+			DeflateStreamPtr primed;
+			DeflateStreamPtr stream;
+		};
+
+	} // namespace detail
+
+	// Compresses into the framing chosen by Format, see format.hpp. Compressor produces gzip.
+	template <typename Format = GzipFormat<>>
+	class BasicCompressor {
+		std::size_t max_;
+		int level_;
+		Allocator* allocator_;
+		Dictionary const* dictionary_;
+		int window_bits_;
+		detail::DeflateStreamPtr deflate_s_;
+		std::unique_ptr<detail::PrimedDeflateStream> primed_;
+
+		// Returns a stream ready to start a new gzip member. The first call runs deflateInit2,
+		// later calls only deflateReset so the deflate state allocated by zlib is reused.
+		z_stream* acquire_stream() {
+			if (dictionary_) {
+				return acquire_primed_stream();
+			}
+			if (deflate_s_) {
+				deflateReset(deflate_s_.get());
+			} else {
+				deflate_s_ = detail::make_deflate_stream(level_, window_bits_, allocator_, Format::mem_level);
+			}
+			return deflate_s_.get();
+		}
+
+		// deflateSetDictionary hashes the whole dictionary, which costs more than compressing
+		// a small payload, and a reset drops it again. So the dictionary is loaded once into a
+		// stream that is never written to, and each call starts from a deflateCopy of it. The
+		// copy reuses the blocks of the previous one through a cache, which takes its blocks
+		// from the allocator when one is set, so that only the first call allocates from it.
+		z_stream* acquire_primed_stream() {
+			if (!primed_) {
+				std::unique_ptr<detail::PrimedDeflateStream> primed(new detail::PrimedDeflateStream);
+				primed->cache.reset(new detail::BlockCache(allocator_));
+				primed->primed = detail::make_deflate_stream(level_, window_bits_, primed->cache.get(), Format::mem_level);
+				deflateSetDictionary(primed->primed.get(),
+									 reinterpret_cast<const Bytef*>(dictionary_->data()),
+									 static_cast<unsigned int>(dictionary_->size()));
+				primed->stream.reset(new z_stream());
+				primed_ = std::move(primed);
+			}
+			z_stream* deflate_s = primed_->stream.get();
+			deflateEnd(deflate_s);
+			if (deflateCopy(deflate_s, primed_->primed.get()) != Z_OK) {
+				// a failed copy may leave the state of the primed stream in the copy
+				deflate_s->state = Z_NULL;
+				throw std::runtime_error("deflate init failed");
+			}
+			return deflate_s;
+		}
+
+	  public:
+		// allocator, when given, supplies the deflate state instead of malloc and must outlive the compressor
+		BasicCompressor(
+			int level = Z_DEFAULT_COMPRESSION,
+			std::size_t max_bytes = 2000000000, // by default refuse operation if uncompressed data is > 2GB
+			Allocator* allocator = nullptr) :
+			max_(max_bytes), level_(level), allocator_(allocator), dictionary_(nullptr), window_bits_(Format::deflate_window_bits) {
+		}
+
+		// Compresses against a preset dictionary, producing zlib framed data that records the
+		// dictionary ID or raw deflate whatever the Format. The dictionary must outlive the compressor.
+		BasicCompressor(
+			Dictionary const& dictionary,
+			DictionaryFraming framing = DictionaryFraming::zlib,
+			int level = Z_DEFAULT_COMPRESSION,
+			std::size_t max_bytes = 2000000000, // by default refuse operation if uncompressed data is > 2GB
+			Allocator* allocator = nullptr) :
+			max_(max_bytes),
+			level_(level),
+			allocator_(allocator),
+			dictionary_(&dictionary),
+			window_bits_(detail::dictionary_window_bits(framing)) {
+		}
+
+		// The dictionary is referenced, not copied, so a temporary would dangle
+		BasicCompressor(Dictionary&&,
+						DictionaryFraming = DictionaryFraming::zlib,
+						int = Z_DEFAULT_COMPRESSION,
+						std::size_t = 2000000000,
+						Allocator* = nullptr) = delete;
+
+		BasicCompressor(BasicCompressor&&) = default;
+		BasicCompressor& operator=(BasicCompressor&&) = default;
+		BasicCompressor(const BasicCompressor&) = delete;
+		BasicCompressor& operator=(const BasicCompressor&) = delete;
+
+		template <typename InputType>
+		void compress(InputType& output,
+					  const char* data,
+					  std::size_t size)
+		{
+
+	#ifdef DEBUG
+			// Verify if size input will fit into unsigned int, type used for zlib's avail_in
+			if (size > std::numeric_limits<unsigned int>::max()) {
+				throw std::runtime_error("size arg is too large to fit into unsigned int type");
+			}
+	#endif
+			if (size > max_) {
+				throw std::runtime_error("size may use more memory than intended when decompressing");
+			}
+
+			z_stream& deflate_s = *acquire_stream();
 			deflate_s.next_in = reinterpret_cast<z_const Bytef*>(data);
 			deflate_s.avail_in = static_cast<unsigned int>(size);
 
+			// deflateBound gives the worst case size of the whole gzip member, so the first round
+			// normally finishes in a single deflate(Z_FINISH) pass even for incompressible input.
+			// The loop only goes around again if the bound does not fit into zlib's unsigned int avail_out.
+			std::size_t increase = deflateBound(&deflate_s, static_cast<uLong>(size));
 			std::size_t size_compressed = 0;
 			do {
-				size_t increase = size / 2 + 1024;
-				if (output.size() < (size_compressed + increase)) {
-					output.resize(size_compressed + increase);
+				if (increase > std::numeric_limits<unsigned int>::max()) {
+					increase = std::numeric_limits<unsigned int>::max();
+				}
+				if (OutputTraits<InputType>::size(output) < (size_compressed + increase)) {
+					OutputTraits<InputType>::resize(output, size_compressed + increase);
 				}
-				// There is no way we see that "increase" would not fit in an unsigned int,
+				// "increase" is clamped to fit in an unsigned int above,
 				// hence we use static cast here to avoid -Wshorten-64-to-32 error
 				deflate_s.avail_out = static_cast<unsigned int>(increase);
-				deflate_s.next_out = reinterpret_cast<Bytef*>((&output[0] + size_compressed));
+				deflate_s.next_out = reinterpret_cast<Bytef*>(OutputTraits<InputType>::data(output) + size_compressed);
 				// From http://www.zlib.net/zlib_how.html
 				// "deflate() has a return value that can indicate errors, yet we do not check it here.
 				// Why not? Well, it turns out that deflate() can do no wrong here."
 				// Basically only possible error is from deflateInit not working properly
 				deflate(&deflate_s, Z_FINISH);
 				size_compressed += (increase - deflate_s.avail_out);
+				increase = size / 2 + 1024;
 			} while (deflate_s.avail_out == 0);
 
-			deflateEnd(&deflate_s);
-			output.resize(size_compressed);
+			OutputTraits<InputType>::resize(output, size_compressed);
+		}
+
+		// Compresses count segments of input as one gzip member, as if they were concatenated,
+		// without gathering them into one buffer first. deflate sees each segment in turn with
+		// Z_NO_FLUSH, so the output is the same as compressing the concatenation.
+		template <typename InputType>
+		void compress(InputType& output,
+					  Segment const* segments,
+					  std::size_t count)
+		{
+			std::size_t size = 0;
+			for (std::size_t index = 0; index < count; ++index) {
+				size += segments[index].iov_len;
+			}
+			if (size > max_) {
+				throw std::runtime_error("size may use more memory than intended when decompressing");
+			}
+
+			z_stream& deflate_s = *acquire_stream();
+			deflate_s.avail_in = 0;
+			deflate_s.avail_out = 0;
+			const char* next = nullptr;
+			std::size_t left = 0;
+			std::size_t index = 0;
+
+			// sized by deflateBound like the single buffer compress, which normally suffices
+			std::size_t increase = deflateBound(&deflate_s, static_cast<uLong>(size));
+			std::size_t size_compressed = 0;
+			int ret = Z_OK;
+			while (ret != Z_STREAM_END) {
+				if (deflate_s.avail_in == 0) {
+					while (left == 0 && index < count) {
+						next = static_cast<const char*>(segments[index].iov_base);
+						left = segments[index].iov_len;
+						++index;
+					}
+					// segments larger than zlib's unsigned int avail_in are fed in parts
+					std::size_t part = std::min<std::size_t>(left, std::numeric_limits<unsigned int>::max());
+					deflate_s.next_in = reinterpret_cast<z_const Bytef*>(next);
+					deflate_s.avail_in = static_cast<unsigned int>(part);
+					next += part;
+					left -= part;
+				}
+				if (deflate_s.avail_out == 0) {
+					increase = std::min<std::size_t>(increase, std::numeric_limits<unsigned int>::max());
+					OutputTraits<InputType>::resize(output, size_compressed + increase);
+					deflate_s.avail_out = static_cast<unsigned int>(increase);
+					deflate_s.next_out = reinterpret_cast<Bytef*>(OutputTraits<InputType>::data(output) + size_compressed);
+					increase = size / 2 + 1024;
+				}
+				std::size_t room = deflate_s.avail_out;
+				ret = deflate(&deflate_s, left == 0 && index == count ? Z_FINISH : Z_NO_FLUSH);
+				size_compressed += room - deflate_s.avail_out;
+			}
+
+			OutputTraits<InputType>::resize(output, size_compressed);
+		}
+
+		// Compresses into capacity bytes at output, allocating nothing once the deflate state
+		// exists: the first call on an instance allocates it unless an allocator supplies it.
+		// Output that fits exactly succeeds; otherwise insufficient_space is reported.
+		WriteResult compress_into(char* output,
+								  std::size_t capacity,
+								  const char* data,
+								  std::size_t size)
+		{
+	#ifdef DEBUG
+			// Verify if size input will fit into unsigned int, type used for zlib's avail_in
+			if (size > std::numeric_limits<unsigned int>::max()) {
+				throw std::runtime_error("size arg is too large to fit into unsigned int type");
+			}
+	#endif
+			if (size > max_) {
+				throw std::runtime_error("size may use more memory than intended when decompressing");
+			}
+
+			z_stream& deflate_s = *acquire_stream();
+			deflate_s.next_in = reinterpret_cast<z_const Bytef*>(data);
+			deflate_s.avail_in = static_cast<unsigned int>(size);
+
+			std::size_t size_compressed = 0;
+			int ret = Z_OK;
+			while (ret != Z_STREAM_END && size_compressed < capacity) {
+				std::size_t room = std::min<std::size_t>(capacity - size_compressed, std::numeric_limits<unsigned int>::max());
+				deflate_s.avail_out = static_cast<unsigned int>(room);
+				deflate_s.next_out = reinterpret_cast<Bytef*>(output + size_compressed);
+				ret = deflate(&deflate_s, Z_FINISH);
+				size_compressed += room - deflate_s.avail_out;
+			}
+			if (ret != Z_STREAM_END) {
+				// deflate can fill the output with the last byte and only report the end on
+				// the next call, so offer it one more byte: if it needs that, it did not fit
+				char probe;
+				deflate_s.avail_out = 1;
+				deflate_s.next_out = reinterpret_cast<Bytef*>(&probe);
+				if (deflate(&deflate_s, Z_FINISH) != Z_STREAM_END || deflate_s.avail_out == 0) {
+					return WriteResult{size_compressed, true};
+				}
+			}
+			return WriteResult{size_compressed, false};
 		}
 	};
 
+	using Compressor = BasicCompressor<>;
+
 	inline std::string compress(
 		const char* data,
 		std::size_t size,
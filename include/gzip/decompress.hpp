@@ -1,94 +1,485 @@
 #ifndef GZIP_DECOMPRESS_HPP_INCLUDED
 #define GZIP_DECOMPRESS_HPP_INCLUDED
 
+#include <gzip/allocator.hpp>
+#include <gzip/buffer.hpp>
+#include <gzip/chunked_buffer.hpp>
 #include <gzip/config.hpp>
+#include <gzip/dictionary.hpp>
+#include <gzip/format.hpp>
+#include <gzip/output.hpp>
+#include <gzip/utils.hpp>
 
 // zlib
 #include <zlib.h>
 
 // std
+#include <algorithm>
+#include <cstdint>
 #include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace gzip {
 
-	class Decompressor {
+	namespace detail {
+
+		struct InflateStreamDeleter {
+			void operator()(z_stream* inflate_s) const {
+				inflateEnd(inflate_s);
+				delete inflate_s;
+			}
+		};
+
+		using InflateStreamPtr = std::unique_ptr<z_stream, InflateStreamDeleter>;
+
+		// The windowBits parameter is the base two logarithm of the window size (the size of the history buffer).
+		// It should be in the range 8..15 for this version of the library.
+		// Larger values of this parameter result in better compression at the expense of memory usage.
+		// This range of values also changes the decoding type:
+		//  -8 to -15 for raw deflate
+		//  8 to 15 for zlib
+		// (8 to 15) + 16 for gzip
+		// (8 to 15) + 32 to automatically detect gzip/zlib header
+		constexpr int inflate_window_bits = 15 + 32; // auto with windowbits of 15
+
+		// Allocates and initializes an inflate stream accepting both gzip and zlib input unless told otherwise.
+		// The z_stream is heap allocated because zlib keeps a back pointer to it in its
+		// internal state, so owners can move without moving the stream itself.
+		// zlib's own state comes from allocator when one is given, otherwise from malloc.
+		inline InflateStreamPtr make_inflate_stream(int window_bits = inflate_window_bits, Allocator* allocator = nullptr) {
+			std::unique_ptr<z_stream> inflate_s(new z_stream);
+			set_allocator(*inflate_s, allocator);
+			inflate_s->avail_in = 0;
+			inflate_s->next_in = Z_NULL;
+
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wold-style-cast"
+			if (inflateInit2(inflate_s.get(), window_bits) != Z_OK) {
+				throw std::runtime_error("inflate init failed");
+			}
+	#pragma GCC diagnostic pop
+
+			return InflateStreamPtr(inflate_s.release());
+		}
+
+		// A reset inflate stream owned by the calling thread, the inflate counterpart of
+		// local_deflate_stream. inflateReset2 switches the window bits in place.
+		inline z_stream& local_inflate_stream(int window_bits) {
+			static thread_local InflateStreamPtr cached;
+			if (cached) {
+				if (inflateReset2(cached.get(), window_bits) != Z_OK) {
+					throw std::runtime_error("inflate init failed");
+				}
+			} else {
+				cached = make_inflate_stream(window_bits);
+			}
+			return *cached;
+		}
+
+	} // namespace detail
+
+	// Decides how much output space Decompressor adds each time inflate fills the output.
+	//  - geometric: start at twice the input size, then double the output on every round so
+	//    the total bytes moved by reallocations stay linear in the output size (the default)
+	//  - fixed: add the same chunk every round, 0 means twice the input size
+	//  - hint: start at a caller supplied expected size, then continue geometrically
+	class GrowthPolicy {
+	  public:
+		enum class Kind {
+			geometric,
+			fixed,
+			hint
+		};
+
+	  private:
+		Kind kind_;
+		std::size_t amount_;
+
+		GrowthPolicy(Kind kind, std::size_t amount) : kind_(kind), amount_(amount) {}
+
+	  public:
+		GrowthPolicy() : GrowthPolicy(Kind::geometric, 0) {}
+
+		static GrowthPolicy geometric() { return GrowthPolicy(Kind::geometric, 0); }
+		static GrowthPolicy fixed(std::size_t chunk = 0) { return GrowthPolicy(Kind::fixed, chunk); }
+		static GrowthPolicy hint(std::size_t expected_size) { return GrowthPolicy(Kind::hint, expected_size); }
+
+		Kind kind() const { return kind_; }
+
+		// Bytes of output to allocate before the first call to inflate
+		std::size_t initial(std::size_t input_size) const {
+			if (kind_ != Kind::geometric && amount_ > 0) {
+				return amount_;
+			}
+			return default_chunk(input_size);
+		}
+
+		// Bytes of output to add once the first produced bytes are filled
+		std::size_t next(std::size_t produced, std::size_t input_size) const {
+			if (kind_ == Kind::fixed) {
+				return initial(input_size);
+			}
+			return std::max(produced, default_chunk(input_size));
+		}
+
+	  private:
+		static std::size_t default_chunk(std::size_t input_size) {
+			// never hand inflate an empty output buffer, even for empty or tiny input
+			return std::max<std::size_t>(2 * input_size, 1024);
+		}
+	};
+
+	// Where one gzip member sits in the compressed input and in the decompressed output
+	struct Member {
+		std::size_t compressed_offset;
+		std::size_t compressed_size;
+		std::size_t uncompressed_offset;
+		std::size_t uncompressed_size;
+	};
+
+	// Decompresses the framing chosen by Format, see format.hpp. Decompressor reads gzip or zlib.
+	template <typename Format = AutoFormat<>>
+	class BasicDecompressor {
 		std::size_t max_;
+		bool use_isize_;
+		GrowthPolicy growth_;
+		Allocator* allocator_;
+		Dictionary const* dictionary_;
+		int window_bits_;
+		detail::InflateStreamPtr inflate_s_;
+
+		// Returns a stream ready to decode a new buffer. The first call runs inflateInit2,
+		// later calls only inflateReset2 so the inflate state and its 32Kb window are reused.
+		// Raw deflate has no header asking for the dictionary, so it is loaded up front.
+		z_stream* acquire_stream(int window_bits) {
+			if (inflate_s_) {
+				inflateReset2(inflate_s_.get(), window_bits);
+			} else {
+				inflate_s_ = detail::make_inflate_stream(window_bits, allocator_);
+			}
+			if (dictionary_ && window_bits < 0) {
+				set_dictionary(*inflate_s_);
+			}
+			return inflate_s_.get();
+		}
+
+		// For zlib framed input, inflateSetDictionary runs adler32 over the whole dictionary on
+		// every call to check it against the header, which costs more than inflating a small
+		// payload. So when the header names this dictionary it is skipped here, the deflate
+		// data is inflated raw and the adler32 trailer is checked against the output instead.
+		// Returns the size of the skipped header, or 0 to let zlib parse the input.
+		std::size_t dictionary_header_size(const char* data, std::size_t size) const {
+			std::uint32_t id = 0;
+			if (!dictionary_ || window_bits_ < 0 || !dictionary_id(data, size, id)) {
+				return 0;
+			}
+			if (id != dictionary_->id()) {
+				throw std::runtime_error("compressed data needs a different preset dictionary");
+			}
+			return 6;
+		}
+
+		static uLong adler(uLong check, const char* data, std::size_t size) {
+			return adler32(check, reinterpret_cast<const Bytef*>(data), static_cast<unsigned int>(size));
+		}
+
+		// Checks the adler32 trailer of zlib framed input inflated raw after its header was
+		// skipped by dictionary_header_size against the output's check value, and consumes
+		// it like inflate does in zlib mode
+		static void check_dictionary_trailer(z_stream& inflate_s, uLong check) {
+			const char* trailer = reinterpret_cast<const char*>(inflate_s.next_in);
+			if (inflate_s.avail_in < 4 || detail::get_be32(trailer) != check) {
+				throw std::runtime_error("incorrect data check");
+			}
+			inflate_s.next_in += 4;
+			inflate_s.avail_in -= 4;
+		}
+
+		// Concatenated gzip members (cat a.gz b.gz) decode as one output: once the member that
+		// began at begin ends, resets inflate if it was gzip and another member follows, and
+		// moves begin to it. inflateReset keeps the allocated state and window; anything that is
+		// not another member is ignored. zlib and raw data end at the first stream, even under
+		// AutoFormat when a gzip member comes after it.
+		static bool next_member(z_stream& inflate_s, const char* data, std::size_t size, std::size_t& begin) {
+			std::size_t consumed = size - inflate_s.avail_in;
+			if (!Format::multi_member ||
+				!detail::is_gzip_member(data + begin, size - begin) ||
+				!detail::is_gzip_member(data + consumed, size - consumed)) {
+				return false;
+			}
+			inflateReset(&inflate_s);
+			begin = consumed;
+			return true;
+		}
+
+		void set_dictionary(z_stream& inflate_s) const {
+			inflateSetDictionary(&inflate_s,
+								 reinterpret_cast<const Bytef*>(dictionary_->data()),
+								 static_cast<unsigned int>(dictionary_->size()));
+		}
 
 	  public:
-		Decompressor(std::size_t max_bytes = 1000000000) : // by default refuse operation if compressed data is > 1GB
-			max_(max_bytes) {
+		// When use_isize is set, the ISIZE field of a gzip trailer is used to size the output
+		// up front so single member input inflates in exactly one pass. Input where ISIZE is
+		// wrong (multi-member, > 4GB or zlib framed data) or more than the input can decode to
+		// falls back to growing the output as described by the growth policy. allocator, when given, supplies the inflate
+		// state and window instead of malloc and must outlive the decompressor.
+		BasicDecompressor(std::size_t max_bytes = 1000000000, // by default refuse operation if compressed data is > 1GB
+					 bool use_isize = false,
+					 GrowthPolicy growth = GrowthPolicy::geometric(),
+					 Allocator* allocator = nullptr) :
+			max_(max_bytes),
+			use_isize_(use_isize),
+			growth_(growth),
+			allocator_(allocator),
+			dictionary_(nullptr),
+			window_bits_(Format::inflate_window_bits) {
 		}
 
+		// Decompresses data produced by a Compressor with the same dictionary and framing,
+		// whatever the Format. zlib framed input must name this dictionary's ID. The
+		// dictionary must outlive the decompressor.
+		BasicDecompressor(Dictionary const& dictionary,
+					 DictionaryFraming framing = DictionaryFraming::zlib,
+					 std::size_t max_bytes = 1000000000, // by default refuse operation if compressed data is > 1GB
+					 GrowthPolicy growth = GrowthPolicy::geometric(),
+					 Allocator* allocator = nullptr) :
+			max_(max_bytes),
+			use_isize_(false),
+			growth_(growth),
+			allocator_(allocator),
+			dictionary_(&dictionary),
+			window_bits_(detail::dictionary_window_bits(framing)) {
+		}
+
+		// The dictionary is referenced, not copied, so a temporary would dangle
+		BasicDecompressor(Dictionary&&,
+						  DictionaryFraming = DictionaryFraming::zlib,
+						  std::size_t = 1000000000,
+						  GrowthPolicy = GrowthPolicy::geometric(),
+						  Allocator* = nullptr) = delete;
+
+		BasicDecompressor(BasicDecompressor&&) = default;
+		BasicDecompressor& operator=(BasicDecompressor&&) = default;
+		BasicDecompressor(const BasicDecompressor&) = delete;
+		BasicDecompressor& operator=(const BasicDecompressor&) = delete;
+
 		template <typename OutputType>
 		void decompress(OutputType& output,
 						const char* data,
-						std::size_t size) const
+						std::size_t size)
 		{
-			z_stream inflate_s;
-
-			inflate_s.zalloc = Z_NULL;
-			inflate_s.zfree = Z_NULL;
-			inflate_s.opaque = Z_NULL;
-			inflate_s.avail_in = 0;
-			inflate_s.next_in = Z_NULL;
-
-			// The windowBits parameter is the base two logarithm of the window size (the size of the history buffer).
-			// It should be in the range 8..15 for this version of the library.
-			// Larger values of this parameter result in better compression at the expense of memory usage.
-			// This range of values also changes the decoding type:
-			//  -8 to -15 for raw deflate
-			//  8 to 15 for zlib
-			// (8 to 15) + 16 for gzip
-			// (8 to 15) + 32 to automatically detect gzip/zlib header
-			constexpr int window_bits = 15 + 32; // auto with windowbits of 15
+			decompress_members(output, data, size, nullptr);
+		}
 
-	#pragma GCC diagnostic push
-	#pragma GCC diagnostic ignored "-Wold-style-cast"
-			if (inflateInit2(&inflate_s, window_bits) != Z_OK) {
-				throw std::runtime_error("inflate init failed");
+		// Same as above, and also reports where each gzip member starts and ends
+		template <typename OutputType>
+		void decompress(OutputType& output,
+						const char* data,
+						std::size_t size,
+						std::vector<Member>& members)
+		{
+			members.clear();
+			decompress_members(output, data, size, &members);
+		}
+
+		// Same as above into a ChunkedBuffer: the output grows a chunk at a time and bytes
+		// already decompressed never move. Chunks past max_bytes are not handed out.
+		void decompress(ChunkedBuffer& output,
+						const char* data,
+						std::size_t size)
+		{
+			output.clear();
+			std::size_t chunk_size = std::min<std::size_t>(output.chunk_size(), std::numeric_limits<unsigned int>::max());
+			WriteResult result = {0, false};
+			try {
+				result = inflate_members(
+					data, size, nullptr,
+					[&](std::size_t) -> Window {
+						if (output.size() >= max_) {
+							throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+						}
+						char* chunk = output.grow();
+						// output past max_bytes is refused, as by the other decompress calls
+						std::size_t over = output.size() > max_ ? output.size() - max_ : 0;
+						output.trim(output.chunk_size() - chunk_size + over);
+						return Window{chunk, chunk_size - over};
+					},
+					[&](std::size_t produced) {
+						uLong check = adler32(0L, Z_NULL, 0);
+						for (Segment const& segment : output.segments()) {
+							std::size_t length = std::min(segment.iov_len, produced);
+							check = adler(check, static_cast<const char*>(segment.iov_base), length);
+							produced -= length;
+						}
+						return check;
+					});
+			} catch (...) {
+				output.clear();
+				throw;
 			}
-	#pragma GCC diagnostic pop
-			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data);
+			output.trim(output.size() - result.size);
+		}
+
+		// Decompresses into capacity bytes at output, allocating nothing once the inflate state
+		// exists: the first call on an instance allocates it unless an allocator supplies it.
+		// Output that fits exactly succeeds; otherwise insufficient_space is reported. Like
+		// decompress, input that ends before the end of the stream yields what it decodes to.
+		WriteResult decompress_into(char* output,
+									std::size_t capacity,
+									const char* data,
+									std::size_t size)
+		{
+			return inflate_members(
+				data, size, nullptr,
+				[&](std::size_t produced) {
+					return Window{output + produced, capacity - produced};
+				},
+				[&](std::size_t produced) {
+					return adler(adler32(0L, Z_NULL, 0), output, produced);
+				});
+		}
+
+	  private:
+		// Where inflate writes next. An empty window tells the loop the output is full.
+		struct Window {
+			char* data;
+			std::size_t size;
+		};
+
+		template <typename OutputType>
+		void decompress_members(OutputType& output,
+								const char* data,
+								std::size_t size,
+								std::vector<Member>* members)
+		{
+			std::size_t capacity = 0;
+			WriteResult result = inflate_members(
+				data, size, members,
+				[&](std::size_t produced) -> Window {
+					std::size_t increase = growth_.next(produced, size);
+					if (capacity == 0) {
+						increase = growth_.initial(size);
+						std::uint32_t isize = 0;
+						// ISIZE is untrusted: a value the input can not decode to is ignored
+						if (use_isize_ && read_isize(data, size, isize) && isize > 0 && isize / detail::max_inflate_ratio <= size) {
+							if (isize > max_) {
+								throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+							}
+							increase = isize;
+						}
+					}
+					// Growth is capped at max_ rather than refused outright, so output of up to
+					// max_ bytes always succeeds whatever the policy. Once max_ bytes are produced
+					// and inflate still wants room, the partial output is dropped and we throw.
+					increase = std::min(increase, max_ - capacity);
+					increase = std::min<std::size_t>(increase, std::numeric_limits<unsigned int>::max());
+					if (increase == 0) {
+						OutputTraits<OutputType>::resize(output, 0);
+						throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+					}
+					capacity += increase;
+					OutputTraits<OutputType>::resize(output, capacity);
+					return Window{OutputTraits<OutputType>::data(output) + produced, increase};
+				},
+				[&](std::size_t produced) {
+					return adler(adler32(0L, Z_NULL, 0), produced > 0 ? OutputTraits<OutputType>::data(output) : nullptr, produced);
+				});
+			OutputTraits<OutputType>::resize(output, result.size);
+		}
 
+		// The inflate loop behind every decompress call. Whenever inflate has filled its output,
+		// next_window(produced) says where the following bytes go, produced being the bytes
+		// written so far; output_check(produced) returns their adler32 for the trailer of zlib
+		// input whose dictionary header was skipped. Ends at the end of the last member, at the
+		// end of the input, or with insufficient_space once a window comes back empty and
+		// inflate still has output to write. Member boundaries go to members when given.
+		template <typename NextWindow, typename OutputCheck>
+		WriteResult inflate_members(const char* data,
+									std::size_t size,
+									std::vector<Member>* members,
+									NextWindow next_window,
+									OutputCheck output_check)
+		{
 	#ifdef DEBUG
 			// Verify if size (long type) input will fit into unsigned int, type used for zlib's avail_in
 			std::uint64_t size_64 = size * 2;
 			if (size_64 > std::numeric_limits<unsigned int>::max()) {
-				inflateEnd(&inflate_s);
 				throw std::runtime_error("size arg is too large to fit into unsigned int type x2");
 			}
 	#endif
 			if (size > max_ || (size * 2) > max_) {
-				inflateEnd(&inflate_s);
 				throw std::runtime_error("size may use more memory than intended when decompressing");
 			}
-			inflate_s.avail_in = static_cast<unsigned int>(size);
-			std::size_t size_uncompressed = 0;
-			do {
-				std::size_t resize_to = size_uncompressed + 2 * size;
-				if (resize_to > max_) {
-					inflateEnd(&inflate_s);
-					throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+
+			// A stream left half way by a previous call that threw is brought back to
+			// a clean state by the reset in acquire_stream, so no cleanup is needed on error paths.
+			std::size_t header = dictionary_header_size(data, size);
+			z_stream& inflate_s = *acquire_stream(header > 0 ? -15 : window_bits_);
+			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data + header);
+			inflate_s.avail_in = static_cast<unsigned int>(size - header);
+			inflate_s.avail_out = 0;
+
+			std::size_t produced = 0;
+			bool full = false;
+			// zlib needs somewhere to point next_out even when there is no room, e.g. for an
+			// empty member decoded into a null output of capacity 0
+			char empty = 0;
+			Member member = {0, 0, 0, 0};
+			for (;;) {
+				if (inflate_s.avail_out == 0) {
+					if (full) {
+						return WriteResult{produced, true};
+					}
+					Window window = next_window(produced);
+					std::size_t room = std::min<std::size_t>(window.size, std::numeric_limits<unsigned int>::max());
+					// with no room left, one more call still lets a stream that needs none end
+					full = room == 0;
+					inflate_s.next_out = reinterpret_cast<Bytef*>(room > 0 ? window.data : &empty);
+					inflate_s.avail_out = static_cast<unsigned int>(room);
 				}
-				output.resize(resize_to);
-				inflate_s.avail_out = static_cast<unsigned int>(2 * size);
-				inflate_s.next_out = reinterpret_cast<Bytef*>(&output[0] + size_uncompressed);
+				unsigned int avail_out = inflate_s.avail_out;
 				int ret = inflate(&inflate_s, Z_FINISH);
+				produced += avail_out - inflate_s.avail_out;
+				if (ret == Z_NEED_DICT) {
+					// the zlib header names the dictionary by ID, reported in adler
+					if (!dictionary_ || inflate_s.adler != dictionary_->id()) {
+						throw std::runtime_error("compressed data needs a different preset dictionary");
+					}
+					set_dictionary(inflate_s);
+					continue;
+				}
 				if (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR) {
-					std::string error_msg = inflate_s.msg;
-					inflateEnd(&inflate_s);
-					throw std::runtime_error(error_msg);
+					throw std::runtime_error(inflate_s.msg != Z_NULL ? inflate_s.msg : "inflate failed");
 				}
-
-				size_uncompressed += (2 * size - inflate_s.avail_out);
-			} while (inflate_s.avail_out == 0);
-			inflateEnd(&inflate_s);
-			output.resize(size_uncompressed);
+				if (ret == Z_STREAM_END) {
+					if (header > 0) {
+						check_dictionary_trailer(inflate_s, output_check(produced));
+					}
+					std::size_t consumed = size - inflate_s.avail_in;
+					if (members) {
+						member.compressed_size = consumed - member.compressed_offset;
+						member.uncompressed_size = produced - member.uncompressed_offset;
+						members->push_back(member);
+					}
+					if (!next_member(inflate_s, data, size, member.compressed_offset)) {
+						return WriteResult{produced, false};
+					}
+					member.uncompressed_offset = produced;
+					full = false;
+				} else if (inflate_s.avail_out != 0) {
+					// input exhausted before the end of the stream
+					return WriteResult{produced, false};
+				}
+			}
 		}
 	};
 
+	using Decompressor = BasicDecompressor<>;
+
 	inline std::string decompress(const char* data, std::size_t size) {
 		Decompressor decomp;
 		std::string output;
@@ -0,0 +1,72 @@
+#ifndef GZIP_DICTIONARY_HPP_INCLUDED
+#define GZIP_DICTIONARY_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace gzip {
+
+	// How data compressed against a preset dictionary is framed. The gzip format has no
+	// field for a dictionary, so dictionaries need zlib framing, whose header carries the
+	// dictionary ID and whose adler32 trailer is checked, or raw deflate without any framing.
+	enum class DictionaryFraming {
+		zlib,
+		raw
+	};
+
+	// A preset dictionary: bytes likely to occur in the data (shared keys, layer names,
+	// boilerplate) that deflate can reference from the very first byte, which is what makes
+	// small payloads compress well. Only the last 32Kb of longer input are kept, as deflate
+	// can not reach further back; put the most useful strings at the end. The ID is the
+	// adler32 of the kept bytes, the same value zlib writes into the zlib header.
+	class Dictionary {
+		std::string data_;
+		std::uint32_t id_;
+
+	  public:
+		Dictionary(const char* data, std::size_t size) :
+			data_(data + size - std::min(size, detail::deflate_window_size), std::min(size, detail::deflate_window_size)),
+			id_(static_cast<std::uint32_t>(adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data_.data()), static_cast<unsigned int>(data_.size())))) {
+		}
+
+		explicit Dictionary(std::string const& data) : Dictionary(data.data(), data.size()) {}
+
+		const char* data() const { return data_.data(); }
+		std::size_t size() const { return data_.size(); }
+		std::uint32_t id() const { return id_; }
+	};
+
+	// Reads the ID of the dictionary zlib framed data was compressed with. Returns false if
+	// the data is not zlib framed or was compressed without a dictionary.
+	inline bool dictionary_id(const char* data, std::size_t size, std::uint32_t& id) {
+		if (size < 6) {
+			return false;
+		}
+		auto const cmf = static_cast<unsigned char>(data[0]);
+		auto const flg = static_cast<unsigned char>(data[1]);
+		if ((cmf & 0x0F) != Z_DEFLATED || (cmf * 256 + flg) % 31 != 0 || (flg & 0x20) == 0) {
+			return false;
+		}
+		id = detail::get_be32(data + 2);
+		return true;
+	}
+
+	namespace detail {
+
+		inline int dictionary_window_bits(DictionaryFraming framing) {
+			return framing == DictionaryFraming::raw ? -15 : 15;
+		}
+
+	} // namespace detail
+
+} // namespace gzip
+
+#endif
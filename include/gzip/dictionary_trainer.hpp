@@ -0,0 +1,190 @@
+#ifndef GZIP_DICTIONARY_TRAINER_HPP_INCLUDED
+#define GZIP_DICTIONARY_TRAINER_HPP_INCLUDED
+
+#include <gzip/dictionary.hpp>
+#include <gzip/utils.hpp>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gzip {
+
+	// Builds a preset dictionary from sample payloads, following the COVER algorithm of zstd.
+	// Every k-mer (a kmer_size byte substring) is scored by the number of samples it occurs
+	// in; repeats inside one sample do not count, deflate finds those without a dictionary.
+	// The samples are then split into epochs, one per segment the dictionary can hold, and
+	// from each epoch the segment_size window whose distinct k-mers score highest is taken.
+	// The k-mers of a chosen segment stop scoring, so later segments cover new content.
+	// Segments are laid out by score, the best last: deflate reaches the end of the
+	// dictionary with the shortest distances, and the end is what survives truncation.
+	class DictionaryTrainer {
+		std::size_t capacity_;
+		std::size_t segment_size_;
+		std::size_t kmer_size_;
+		std::string corpus_;
+		std::vector<std::size_t> ends_;
+
+		struct Count {
+			std::uint32_t samples;
+			std::uint32_t last_sample;
+		};
+
+		struct Segment {
+			std::uint64_t score;
+			std::size_t begin;
+			std::size_t end;
+		};
+
+		std::uint64_t kmer(std::size_t at) const {
+			std::uint64_t key = 0;
+			for (std::size_t i = 0; i < kmer_size_; ++i) {
+				key = key << 8 | static_cast<unsigned char>(corpus_[at + i]);
+			}
+			return key;
+		}
+
+	  public:
+		// capacity is capped at 32Kb, the part of a dictionary deflate can use. kmer_size is
+		// clamped to [3, 8], deflate matches are at least 3 bytes long. Long segments work
+		// best for deflate, which pays per match: whole records of shared text beat many
+		// short fragments.
+		DictionaryTrainer(std::size_t capacity = detail::deflate_window_size,
+						  std::size_t segment_size = 1024,
+						  std::size_t kmer_size = 8) :
+			capacity_(std::min(capacity, detail::deflate_window_size)),
+			kmer_size_(std::min<std::size_t>(std::max<std::size_t>(kmer_size, 3), 8)) {
+			segment_size_ = std::max(segment_size, kmer_size_);
+		}
+
+		void add_sample(const char* data, std::size_t size) {
+			corpus_.append(data, size);
+			ends_.push_back(corpus_.size());
+		}
+
+		void add_sample(std::string const& sample) {
+			add_sample(sample.data(), sample.size());
+		}
+
+		std::size_t samples() const { return ends_.size(); }
+
+		Dictionary train() const {
+			std::size_t size = corpus_.size();
+			// number every distinct k-mer once, positions where no k-mer fits get none
+			constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+			std::vector<std::uint32_t> ids(size, none);
+			std::vector<Count> counts;
+			{
+				std::unordered_map<std::uint64_t, std::uint32_t> numbers;
+				std::size_t begin = 0;
+				for (std::size_t sample = 0; sample < ends_.size(); ++sample) {
+					for (std::size_t at = begin; at + kmer_size_ <= ends_[sample]; ++at) {
+						auto inserted = numbers.emplace(kmer(at), static_cast<std::uint32_t>(counts.size()));
+						if (inserted.second) {
+							counts.push_back(Count{0, 0});
+						}
+						ids[at] = inserted.first->second;
+						Count& count = counts[ids[at]];
+						if (count.last_sample != sample + 1) {
+							count.last_sample = static_cast<std::uint32_t>(sample + 1);
+							++count.samples;
+						}
+					}
+					begin = ends_[sample];
+				}
+			}
+			// a k-mer seen in a single sample does not help compress the others
+			auto score = [&](std::size_t at) -> std::uint64_t {
+				if (ids[at] == none) {
+					return 0;
+				}
+				std::uint32_t samples = counts[ids[at]].samples;
+				return samples > 1 ? samples : 0;
+			};
+
+			std::size_t segments = std::max<std::size_t>(capacity_ / segment_size_, 1);
+			std::size_t epoch_size = std::max(size / segments, segment_size_);
+			std::vector<Segment> chosen;
+			// occurrences of each k-mer in the current window
+			std::vector<std::uint32_t> active(counts.size(), 0);
+			for (std::size_t epoch = 0; epoch < size; epoch += epoch_size) {
+				std::size_t epoch_end = std::min(epoch + epoch_size, size);
+				// slide a window of segment_size bytes, i.e. of segment_size - kmer_size + 1 k-mers
+				std::uint64_t window_score = 0;
+				Segment best = {0, 0, 0};
+				std::size_t first = epoch;
+				for (std::size_t last = epoch; last < epoch_end; ++last) {
+					if (ids[last] != none && active[ids[last]]++ == 0) {
+						window_score += score(last);
+					}
+					if (last - first + kmer_size_ > segment_size_) {
+						if (ids[first] != none && --active[ids[first]] == 0) {
+							window_score -= score(first);
+						}
+						++first;
+					}
+					if (window_score > best.score) {
+						best = Segment{window_score, first, last};
+					}
+				}
+				for (std::size_t at = first; at < epoch_end; ++at) {
+					if (ids[at] != none) {
+						active[ids[at]] = 0;
+					}
+				}
+				if (best.score == 0) {
+					continue;
+				}
+				// trim k-mers that add nothing from both ends
+				while (score(best.begin) == 0) {
+					++best.begin;
+				}
+				while (score(best.end) == 0) {
+					--best.end;
+				}
+				for (std::size_t at = best.begin; at <= best.end; ++at) {
+					if (ids[at] != none) {
+						counts[ids[at]].samples = 0;
+					}
+				}
+				best.end += kmer_size_;
+				chosen.push_back(best);
+			}
+
+			// keep the best segments that fit, laid out from the least to the most useful
+			std::stable_sort(chosen.begin(), chosen.end(), [](Segment const& a, Segment const& b) {
+				return a.score > b.score;
+			});
+			std::size_t total = 0;
+			std::size_t kept = 0;
+			while (kept < chosen.size() && total + chosen[kept].end - chosen[kept].begin <= capacity_) {
+				total += chosen[kept].end - chosen[kept].begin;
+				++kept;
+			}
+			std::string dictionary;
+			dictionary.reserve(total);
+			for (std::size_t index = kept; index > 0; --index) {
+				Segment const& segment = chosen[index - 1];
+				dictionary.append(corpus_, segment.begin, segment.end - segment.begin);
+			}
+			return Dictionary(dictionary);
+		}
+	};
+
+	// Trains a dictionary of at most capacity bytes from the samples with the default settings
+	inline Dictionary train_dictionary(std::vector<std::string> const& samples,
+									   std::size_t capacity = detail::deflate_window_size) {
+		DictionaryTrainer trainer(capacity);
+		for (auto const& sample : samples) {
+			trainer.add_sample(sample);
+		}
+		return trainer.train();
+	}
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef GZIP_FORMAT_HPP_INCLUDED
+#define GZIP_FORMAT_HPP_INCLUDED
+
+namespace gzip {
+
+	// Framing policies for BasicCompressor and BasicDecompressor, fixing at compile time the
+	// windowBits passed to deflateInit2/inflateInit2 and the deflate memLevel.
+	//  - GzipFormat: gzip header and CRC32 trailer, concatenated members decode as one
+	//  - ZlibFormat: 2 byte header and adler32 trailer
+	//  - RawFormat: bare deflate data without header, trailer or checksum, for trusted links
+	//  - AutoFormat: writes gzip, reads gzip or zlib by looking at the header (the default)
+	// WindowBits is the base two logarithm of the window size; the reader's must be at least
+	// the writer's. MemLevel trades deflate memory for speed, (1 << (MemLevel + 9)) bytes.
+
+	namespace detail {
+
+		template <int WindowBits, int MemLevel>
+		struct FormatLimits {
+			// zlib turns a zlib or gzip windowBits of 8 into 9, and refuses 8 for raw deflate
+			static_assert(WindowBits >= 9 && WindowBits <= 15, "WindowBits must be in [9, 15]");
+			static_assert(MemLevel >= 1 && MemLevel <= 9, "MemLevel must be in [1, 9]");
+		};
+
+	} // namespace detail
+
+	template <int WindowBits = 15, int MemLevel = 8>
+	struct GzipFormat : detail::FormatLimits<WindowBits, MemLevel> {
+		static constexpr int deflate_window_bits = WindowBits + 16;
+		static constexpr int inflate_window_bits = WindowBits + 16;
+		static constexpr int mem_level = MemLevel;
+		static constexpr bool multi_member = true;
+	};
+
+	template <int WindowBits = 15, int MemLevel = 8>
+	struct ZlibFormat : detail::FormatLimits<WindowBits, MemLevel> {
+		static constexpr int deflate_window_bits = WindowBits;
+		static constexpr int inflate_window_bits = WindowBits;
+		static constexpr int mem_level = MemLevel;
+		static constexpr bool multi_member = false;
+	};
+
+	template <int WindowBits = 15, int MemLevel = 8>
+	struct RawFormat : detail::FormatLimits<WindowBits, MemLevel> {
+		static constexpr int deflate_window_bits = -WindowBits;
+		static constexpr int inflate_window_bits = -WindowBits;
+		static constexpr int mem_level = MemLevel;
+		static constexpr bool multi_member = false;
+	};
+
+	template <int WindowBits = 15, int MemLevel = 8>
+	struct AutoFormat : detail::FormatLimits<WindowBits, MemLevel> {
+		static constexpr int deflate_window_bits = WindowBits + 16;
+		static constexpr int inflate_window_bits = WindowBits + 32;
+		static constexpr int mem_level = MemLevel;
+		static constexpr bool multi_member = true;
+	};
+
+} // namespace gzip
+
+#endif
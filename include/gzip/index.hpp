@@ -0,0 +1,356 @@
+#ifndef GZIP_INDEX_HPP_INCLUDED
+#define GZIP_INDEX_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/output.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	// A place where inflate can be restarted: the input offset just past a deflate block
+	// boundary, how many bits of the byte before it belong to the next block, and the
+	// (up to 32Kb of) output preceding the boundary that later back references may reach.
+	struct Checkpoint {
+		std::size_t compressed_offset;
+		std::size_t uncompressed_offset;
+		int bits;
+		std::string window;
+	};
+
+	namespace detail {
+
+		constexpr char index_magic[4] = {'G', 'Z', 'I', 'X'};
+		constexpr std::uint32_t index_version = 1;
+
+		inline unsigned int clamp_avail(std::size_t size) {
+			return static_cast<unsigned int>(std::min<std::size_t>(size, std::numeric_limits<unsigned int>::max()));
+		}
+
+		inline std::size_t consumed(z_stream const& stream, const char* data) {
+			return static_cast<std::size_t>(reinterpret_cast<const char*>(stream.next_in) - data);
+		}
+
+		// Restores a checkpoint on a freshly reset raw inflate stream, inflates and drops the
+		// first skip bytes into discard (at least 32Kb) and then up to length bytes into out.
+		// Returns the bytes written, which is less than length only if the data ends first.
+		inline std::size_t inflate_from(z_stream& inflate_s,
+										char* discard,
+										const char* data,
+										std::size_t size,
+										Checkpoint const& point,
+										std::size_t skip,
+										char* out,
+										std::size_t length) {
+			if (point.bits > 0) {
+				int value = static_cast<std::uint8_t>(data[point.compressed_offset - 1]) >> (8 - point.bits);
+				inflatePrime(&inflate_s, point.bits, value);
+			}
+			if (!point.window.empty()) {
+				inflateSetDictionary(&inflate_s,
+									 reinterpret_cast<const Bytef*>(point.window.data()),
+									 static_cast<unsigned int>(point.window.size()));
+			}
+			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data + point.compressed_offset);
+			inflate_s.avail_in = 0;
+
+			std::size_t produced = 0;
+			bool raw = true;
+			while (produced < length) {
+				// output before the offset is inflated into a scratch window and dropped
+				std::size_t room = skip > 0 ? std::min(skip, deflate_window_size) : length - produced;
+				room = clamp_avail(room);
+				inflate_s.next_out = reinterpret_cast<Bytef*>(skip > 0 ? discard : out + produced);
+				inflate_s.avail_out = static_cast<unsigned int>(room);
+				if (inflate_s.avail_in == 0) {
+					inflate_s.avail_in = clamp_avail(size - consumed(inflate_s, data));
+				}
+				int ret = inflate(&inflate_s, Z_NO_FLUSH);
+				if (ret == Z_BUF_ERROR) {
+					throw std::runtime_error("compressed stream is truncated");
+				}
+				if (ret != Z_STREAM_END && ret != Z_OK) {
+					throw std::runtime_error(inflate_s.msg != Z_NULL ? inflate_s.msg : "inflate failed");
+				}
+				std::size_t have = room - inflate_s.avail_out;
+				if (skip > 0) {
+					skip -= have;
+				} else {
+					produced += have;
+				}
+
+				if (ret == Z_STREAM_END) {
+					// Raw inflate leaves the gzip trailer of the current member unread, later
+					// members are decoded in gzip mode which consumes header and trailer itself.
+					std::size_t pos = consumed(inflate_s, data) + (raw ? gzip_trailer_size : 0);
+					if (pos > size || !is_gzip_member(data + pos, size - pos)) {
+						break;
+					}
+					inflateReset2(&inflate_s, 15 + 16);
+					inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data + pos);
+					inflate_s.avail_in = 0;
+					raw = false;
+				}
+			}
+			return produced;
+		}
+
+	} // namespace detail
+
+	// Random access index over gzip data in the manner of zlib's examples/zran.c. build()
+	// inflates the input once and records a checkpoint after the header and then at the
+	// first deflate block boundary following every `span` bytes of output. Reading at an
+	// uncompressed offset only has to inflate from the nearest checkpoint before it.
+	// Concatenated gzip members are indexed as one stream, like Decompressor decodes them.
+	//
+	// Every checkpoint keeps a 32Kb window, so the index costs about 32Kb per span bytes
+	// of output; pick the span as a trade off between index size and seek cost.
+	class Index {
+		std::size_t span_;
+		std::size_t compressed_size_;
+		std::size_t uncompressed_size_;
+		std::vector<Checkpoint> checkpoints_;
+
+		void add_checkpoint(z_stream const& inflate_s,
+							const char* data,
+							const char* window,
+							std::size_t uncompressed_offset) {
+			Checkpoint point;
+			point.compressed_offset = detail::consumed(inflate_s, data);
+			point.uncompressed_offset = uncompressed_offset;
+			point.bits = inflate_s.data_type & 7;
+			// the window is circular: once full, the oldest byte sits where inflate writes next
+			std::size_t pos = detail::deflate_window_size - inflate_s.avail_out;
+			if (uncompressed_offset >= detail::deflate_window_size) {
+				point.window.reserve(detail::deflate_window_size);
+				point.window.append(window + pos, detail::deflate_window_size - pos);
+				point.window.append(window, pos);
+			} else {
+				point.window.assign(window, pos);
+			}
+			checkpoints_.push_back(std::move(point));
+		}
+
+	  public:
+		Index() : span_(0), compressed_size_(0), uncompressed_size_(0) {}
+
+		static Index build(const char* data,
+						   std::size_t size,
+						   std::size_t span = 1024 * 1024) {
+			Index index;
+			index.span_ = std::max<std::size_t>(span, 1);
+			index.compressed_size_ = size;
+
+			detail::InflateStreamPtr stream = detail::make_inflate_stream();
+			z_stream& inflate_s = *stream;
+			std::unique_ptr<char[]> window(new char[detail::deflate_window_size]);
+			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data);
+			inflate_s.avail_in = 0;
+			inflate_s.avail_out = 0;
+
+			std::size_t produced = 0;
+			std::size_t last = 0;
+			for (;;) {
+				if (inflate_s.avail_out == 0) {
+					inflate_s.next_out = reinterpret_cast<Bytef*>(window.get());
+					inflate_s.avail_out = static_cast<unsigned int>(detail::deflate_window_size);
+				}
+				if (inflate_s.avail_in == 0) {
+					inflate_s.avail_in = detail::clamp_avail(size - detail::consumed(inflate_s, data));
+				}
+				unsigned int avail_out = inflate_s.avail_out;
+				// Z_BLOCK returns after the header and at the end of every deflate block
+				int ret = inflate(&inflate_s, Z_BLOCK);
+				if (ret == Z_BUF_ERROR) {
+					throw std::runtime_error("compressed stream is truncated");
+				}
+				if (ret != Z_STREAM_END && ret != Z_OK) {
+					throw std::runtime_error(inflate_s.msg != Z_NULL ? inflate_s.msg : "inflate failed");
+				}
+				produced += avail_out - inflate_s.avail_out;
+
+				if (ret == Z_STREAM_END) {
+					std::size_t pos = detail::consumed(inflate_s, data);
+					if (!detail::is_gzip_member(data + pos, size - pos)) {
+						break;
+					}
+					inflateReset(&inflate_s);
+					continue;
+				}
+				// bit 128: stopped at a block boundary, bit 64: that was the last block
+				bool boundary = (inflate_s.data_type & 128) != 0 && (inflate_s.data_type & 64) == 0;
+				if (boundary && (index.checkpoints_.empty() || produced - last >= index.span_)) {
+					index.add_checkpoint(inflate_s, data, window.get(), produced);
+					last = produced;
+				}
+			}
+			index.uncompressed_size_ = produced;
+			return index;
+		}
+
+		// Writes the index to a self contained binary blob, little endian throughout
+		std::string serialize() const {
+			std::size_t total = 4 + 4 + 8 * 4;
+			for (auto const& point : checkpoints_) {
+				total += 8 + 8 + 1 + 4 + point.window.size();
+			}
+			std::string output(total, '\0');
+			char* out = &output[0];
+			std::memcpy(out, detail::index_magic, 4);
+			detail::put_le32(out + 4, detail::index_version);
+			detail::put_le64(out + 8, span_);
+			detail::put_le64(out + 16, compressed_size_);
+			detail::put_le64(out + 24, uncompressed_size_);
+			detail::put_le64(out + 32, checkpoints_.size());
+			out += 40;
+			for (auto const& point : checkpoints_) {
+				detail::put_le64(out, point.compressed_offset);
+				detail::put_le64(out + 8, point.uncompressed_offset);
+				out[16] = static_cast<char>(point.bits);
+				detail::put_le32(out + 17, static_cast<std::uint32_t>(point.window.size()));
+				std::memcpy(out + 21, point.window.data(), point.window.size());
+				out += 21 + point.window.size();
+			}
+			return output;
+		}
+
+		// Reads an index written by serialize(), throws if the blob is malformed
+		static Index deserialize(const char* data, std::size_t size) {
+			auto require = [&](bool ok) {
+				if (!ok) {
+					throw std::runtime_error("invalid gzip index");
+				}
+			};
+			auto read64 = [&](std::size_t at) {
+				std::uint64_t value = detail::get_le64(data + at);
+				require(value <= std::numeric_limits<std::size_t>::max());
+				return static_cast<std::size_t>(value);
+			};
+
+			require(size >= 40 && std::memcmp(data, detail::index_magic, 4) == 0);
+			require(detail::get_le32(data + 4) == detail::index_version);
+			Index index;
+			index.span_ = read64(8);
+			index.compressed_size_ = read64(16);
+			index.uncompressed_size_ = read64(24);
+			std::size_t count = read64(32);
+			// every checkpoint takes at least 21 bytes, which also bounds the reserve below
+			require(count <= (size - 40) / 21);
+			index.checkpoints_.reserve(count);
+
+			std::size_t at = 40;
+			for (std::size_t i = 0; i < count; ++i) {
+				require(size - at >= 21);
+				Checkpoint point;
+				point.compressed_offset = read64(at);
+				point.uncompressed_offset = read64(at + 8);
+				point.bits = static_cast<std::uint8_t>(data[at + 16]);
+				std::size_t window = detail::get_le32(data + at + 17);
+				at += 21;
+				require(window <= detail::deflate_window_size && size - at >= window);
+				require(point.bits < 8 && point.compressed_offset >= (point.bits > 0 ? 1u : 0u));
+				require(point.compressed_offset <= index.compressed_size_ &&
+						point.uncompressed_offset <= index.uncompressed_size_);
+				require(i == 0 ? point.uncompressed_offset == 0 : point.uncompressed_offset > index.checkpoints_.back().uncompressed_offset);
+				point.window.assign(data + at, window);
+				at += window;
+				index.checkpoints_.push_back(std::move(point));
+			}
+			require(at == size && (count > 0 || index.uncompressed_size_ == 0));
+			return index;
+		}
+
+		// The last checkpoint at or before the uncompressed offset
+		Checkpoint const& locate(std::size_t offset) const {
+			if (checkpoints_.empty()) {
+				throw std::runtime_error("gzip index is empty");
+			}
+			auto it = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), offset,
+									   [](std::size_t value, Checkpoint const& point) {
+										   return value < point.uncompressed_offset;
+									   });
+			return *(it - 1);
+		}
+
+		std::size_t span() const { return span_; }
+		std::size_t compressed_size() const { return compressed_size_; }
+		std::size_t uncompressed_size() const { return uncompressed_size_; }
+		std::vector<Checkpoint> const& checkpoints() const { return checkpoints_; }
+	};
+
+	// Decompresses byte ranges of indexed gzip data. Each call restores the checkpoint
+	// nearest to the requested offset with inflatePrime and inflateSetDictionary and
+	// inflates from there, so the cost is bounded by the index span rather than the offset.
+	// Like Decompressor, the raw inflate stream is allocated once and reset between calls.
+	class IndexedDecompressor {
+		std::size_t max_;
+		detail::InflateStreamPtr inflate_s_;
+		std::unique_ptr<char[]> discard_;
+
+		z_stream* acquire_stream() {
+			if (inflate_s_) {
+				inflateReset2(inflate_s_.get(), -15);
+			} else {
+				inflate_s_ = detail::make_inflate_stream(-15);
+				discard_.reset(new char[detail::deflate_window_size]);
+			}
+			return inflate_s_.get();
+		}
+
+	  public:
+		IndexedDecompressor(std::size_t max_bytes = 1000000000) : // by default refuse operation if the requested range is > 1GB
+			max_(max_bytes) {
+		}
+
+		IndexedDecompressor(IndexedDecompressor&&) = default;
+		IndexedDecompressor& operator=(IndexedDecompressor&&) = default;
+		IndexedDecompressor(const IndexedDecompressor&) = delete;
+		IndexedDecompressor& operator=(const IndexedDecompressor&) = delete;
+
+		// Fills output with up to length bytes starting at the uncompressed offset. The range
+		// is clipped to the end of the data, so the output is shorter near the end.
+		template <typename OutputType>
+		void decompress(OutputType& output,
+						const char* data,
+						std::size_t size,
+						Index const& index,
+						std::size_t offset,
+						std::size_t length)
+		{
+			if (size != index.compressed_size()) {
+				throw std::runtime_error("gzip index does not match the compressed data");
+			}
+			if (offset >= index.uncompressed_size()) {
+				OutputTraits<OutputType>::resize(output, 0);
+				return;
+			}
+			length = std::min(length, index.uncompressed_size() - offset);
+			if (length > max_) {
+				throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+			}
+
+			Checkpoint const& point = index.locate(offset);
+			z_stream& inflate_s = *acquire_stream();
+			OutputTraits<OutputType>::resize(output, length);
+			std::size_t produced = detail::inflate_from(inflate_s, discard_.get(), data, size, point,
+														offset - point.uncompressed_offset, OutputTraits<OutputType>::data(output), length);
+			OutputTraits<OutputType>::resize(output, produced);
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef GZIP_OUTPUT_HPP_INCLUDED
+#define GZIP_OUTPUT_HPP_INCLUDED
+
+// std
+#include <algorithm>
+#include <string>
+
+namespace gzip {
+
+	namespace detail {
+
+		// Grows an output container before zlib writes into the new bytes, so their initial
+		// value does not matter. Containers that only offer a zero filling resize pay for it.
+		template <typename OutputType>
+		inline void resize_uninitialized(OutputType& output, std::size_t size) {
+			output.resize(size);
+		}
+
+#if defined(__cpp_lib_string_resize_and_overwrite)
+		// C++23 lets std::string skip the fill as long as the bytes are written before use.
+		// resize_and_overwrite reserves exactly the size asked for, so growth is kept
+		// geometric here like resize does it. Strings with other allocators, such as
+		// std::pmr::string, take the same path.
+		template <typename Traits, typename Alloc>
+		inline void resize_uninitialized(std::basic_string<char, Traits, Alloc>& output, std::size_t size) {
+			if (size > output.capacity()) {
+				output.reserve(std::max(size, 2 * output.capacity()));
+			}
+			output.resize_and_overwrite(size, [](char*, std::size_t n) { return n; });
+		}
+#endif
+
+	} // namespace detail
+
+	// How the compressors and decompressors that take an OutputType write into it: Compressor,
+	// Decompressor and their parallel, BGZF, indexed and speculative counterparts.
+	// The default fits any contiguous container of bytes with size(), resize() and
+	// operator[]: std::string, std::vector<char>, std::vector<std::uint8_t>, std::pmr::string
+	// or gzip::Buffer. Other containers, such as buffers that only reserve and append,
+	// specialize OutputTraits with the same three functions:
+	//  - size(output): the current size in bytes
+	//  - resize(output, size): makes the output size bytes long, keeping the bytes it has up
+	//    to that size. New bytes are written before they are read, so need no initial value.
+	//  - data(output): the first byte of a non empty output, valid until the next resize
+	template <typename OutputType>
+	struct OutputTraits {
+		static_assert(sizeof(typename OutputType::value_type) == 1, "output containers must hold bytes");
+
+		static std::size_t size(OutputType const& output) {
+			return output.size();
+		}
+
+		static void resize(OutputType& output, std::size_t size) {
+			detail::resize_uninitialized(output, size);
+		}
+
+		static char* data(OutputType& output) {
+			return reinterpret_cast<char*>(&output[0]);
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef GZIP_PARALLEL_HPP_INCLUDED
+#define GZIP_PARALLEL_HPP_INCLUDED
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gzip {
+
+	// Runs the tasks of the parallel compressors and decompressors. By default each parallel
+	// call starts and joins its own threads; pass an Executor to route the work through a
+	// long lived pool instead, either the built-in ThreadPool (thread_pool.hpp) or an adapter
+	// over the caller's own. The thread calling into gzip always takes part in the work, so
+	// an executor that is busy or runs nothing still makes progress.
+	class Executor {
+	  public:
+		virtual ~Executor() {}
+
+		// Number of threads the executor runs tasks on, used to decide how to split work
+		virtual std::size_t concurrency() const = 0;
+
+		// Runs the task later on any thread. Tasks submitted by gzip never throw.
+		virtual void submit(std::function<void()> task) = 0;
+	};
+
+	namespace detail {
+
+		// Number of workers used when the caller asks for 0 threads
+		inline std::size_t default_concurrency() {
+			return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		// Workers to use for count items: the requested number of threads, or when that is 0,
+		// the executor's threads plus the calling one, or else one per hardware thread
+		inline std::size_t worker_count(std::size_t threads, std::size_t count, Executor* executor) {
+			if (threads == 0) {
+				threads = executor ? executor->concurrency() + 1 : default_concurrency();
+			}
+			return std::max<std::size_t>(std::min(threads, count), 1);
+		}
+
+		// Calls fn(worker, index) for every index in [0, count) spread over up to `workers`
+		// threads, the calling thread being worker 0. Indices are handed out dynamically so
+		// uneven items balance out; `worker` is stable per thread and lets callers keep one
+		// zlib stream per worker. The first exception thrown by fn is rethrown here after
+		// the remaining workers stop picking up new items.
+		//
+		// With an executor the other workers are submitted to it as tasks. Tasks that only
+		// start after the calling thread has run out of items return straight away, so the
+		// call never waits on tasks stuck behind others in the executor's queue.
+		template <typename Fn>
+		void parallel_for(std::size_t count, std::size_t workers, Fn const& fn, Executor* executor = nullptr) {
+			workers = std::min(workers == 0 ? default_concurrency() : workers, count);
+			if (workers <= 1) {
+				for (std::size_t i = 0; i < count; ++i) {
+					fn(std::size_t(0), i);
+				}
+				return;
+			}
+
+			std::atomic<std::size_t> next(0);
+			std::exception_ptr error;
+			std::mutex error_mutex;
+			auto work = [&](std::size_t worker) {
+				try {
+					for (std::size_t i = next++; i < count; i = next++) {
+						fn(worker, i);
+					}
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+					next = count;
+				}
+			};
+
+			if (executor) {
+				struct Latch {
+					std::mutex mutex;
+					std::condition_variable done;
+					std::size_t active = 0;
+					bool closed = false;
+				};
+				// shared so tasks that run after this call returned can still check it
+				auto latch = std::make_shared<Latch>();
+				auto const* task_work = &work;
+				for (std::size_t worker = 1; worker < workers; ++worker) {
+					executor->submit([latch, task_work, worker]() {
+						{
+							std::lock_guard<std::mutex> lock(latch->mutex);
+							if (latch->closed) {
+								return;
+							}
+							++latch->active;
+						}
+						(*task_work)(worker);
+						std::lock_guard<std::mutex> lock(latch->mutex);
+						if (--latch->active == 0) {
+							latch->done.notify_all();
+						}
+					});
+				}
+				work(0);
+				std::unique_lock<std::mutex> lock(latch->mutex);
+				latch->closed = true;
+				latch->done.wait(lock, [&] { return latch->active == 0; });
+			} else {
+				std::vector<std::thread> threads;
+				threads.reserve(workers - 1);
+				for (std::size_t worker = 1; worker < workers; ++worker) {
+					threads.emplace_back(work, worker);
+				}
+				work(0);
+				for (auto& thread : threads) {
+					thread.join();
+				}
+			}
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+
+	} // namespace detail
+
+} // namespace gzip
+
+#endif
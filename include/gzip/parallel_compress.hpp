@@ -0,0 +1,144 @@
+#ifndef GZIP_PARALLEL_COMPRESS_HPP_INCLUDED
+#define GZIP_PARALLEL_COMPRESS_HPP_INCLUDED
+
+#include <gzip/compress.hpp>
+#include <gzip/config.hpp>
+#include <gzip/output.hpp>
+#include <gzip/parallel.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	// Compresses large buffers on several cores the way pigz does: the input is cut into
+	// blocks, each block is deflated independently with the 32Kb of input before it set as
+	// the preset dictionary, and the raw deflate blocks are stitched into a single gzip member.
+	// Blocks other than the last end with a Z_SYNC_FLUSH so they finish on a byte boundary and
+	// the CRC32 of the member is assembled from the per block CRCs with crc32_combine.
+	// The output is ordinary gzip that gzip::decompress (or any gzip reader) decodes.
+	class ParallelCompressor {
+		std::size_t max_;
+		int level_;
+		std::size_t threads_;
+		std::size_t block_size_;
+		Executor* executor_;
+
+		struct Block {
+			std::string data;
+			uLong crc;
+		};
+
+		void compress_block(z_stream& deflate_s,
+							Block& block,
+							const char* data,
+							std::size_t size,
+							std::size_t index,
+							bool last) const {
+			std::size_t begin = index * block_size_;
+			std::size_t length = std::min(block_size_, size - begin);
+
+			deflateReset(&deflate_s);
+			if (begin > 0) {
+				std::size_t dictionary = std::min(begin, detail::deflate_window_size);
+				deflateSetDictionary(&deflate_s,
+									 reinterpret_cast<const Bytef*>(data + begin - dictionary),
+									 static_cast<unsigned int>(dictionary));
+			}
+
+			// a sync flush adds at most a few bytes for the empty stored block marker
+			block.data.resize(deflateBound(&deflate_s, static_cast<uLong>(length)) + 16);
+			deflate_s.next_in = reinterpret_cast<z_const Bytef*>(data + begin);
+			deflate_s.avail_in = static_cast<unsigned int>(length);
+			deflate_s.next_out = reinterpret_cast<Bytef*>(&block.data[0]);
+			deflate_s.avail_out = static_cast<unsigned int>(block.data.size());
+			int ret = deflate(&deflate_s, last ? Z_FINISH : Z_SYNC_FLUSH);
+			if (ret != (last ? Z_STREAM_END : Z_OK) || deflate_s.avail_in != 0) {
+				throw std::runtime_error("deflate failed");
+			}
+			block.data.resize(block.data.size() - deflate_s.avail_out);
+			block.crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data + begin), static_cast<unsigned int>(length));
+		}
+
+		int extra_flags() const {
+			// same XFL value zlib writes: 2 for maximum compression, 4 for the fastest level
+			return level_ == Z_BEST_COMPRESSION ? 2 : (level_ == Z_BEST_SPEED ? 4 : 0);
+		}
+
+	  public:
+		ParallelCompressor(int level = Z_DEFAULT_COMPRESSION,
+						   std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+						   std::size_t block_size = 128 * 1024,
+						   std::size_t max_bytes = 2000000000, // by default refuse operation if uncompressed data is > 2GB
+						   Executor* executor = nullptr) :
+			max_(max_bytes),
+			level_(level),
+			threads_(threads),
+			block_size_(std::min<std::size_t>(std::max<std::size_t>(block_size, detail::deflate_window_size), std::numeric_limits<unsigned int>::max())),
+			executor_(executor) {
+		}
+
+		template <typename OutputType>
+		void compress(OutputType& output,
+					  const char* data,
+					  std::size_t size) const
+		{
+			if (size > max_) {
+				throw std::runtime_error("size may use more memory than intended when decompressing");
+			}
+
+			std::size_t count = std::max<std::size_t>((size + block_size_ - 1) / block_size_, 1);
+			std::vector<Block> blocks(count);
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			detail::parallel_for(count, workers, [&](std::size_t, std::size_t index) {
+				compress_block(detail::local_deflate_stream(level_, -15), blocks[index], data, size, index, index + 1 == count);
+			}, executor_);
+
+			std::size_t total = detail::gzip_header_size + detail::gzip_trailer_size;
+			for (auto const& block : blocks) {
+				total += block.data.size();
+			}
+			OutputTraits<OutputType>::resize(output, total);
+			char* out = OutputTraits<OutputType>::data(output);
+
+			const char header[detail::gzip_header_size] = {'\x1F', '\x8B', Z_DEFLATED, 0, 0, 0, 0, 0, static_cast<char>(extra_flags()), 3};
+			std::memcpy(out, header, detail::gzip_header_size);
+			out += detail::gzip_header_size;
+
+			uLong crc = crc32(0L, Z_NULL, 0);
+			for (std::size_t index = 0; index < count; ++index) {
+				Block const& block = blocks[index];
+				std::memcpy(out, block.data.data(), block.data.size());
+				out += block.data.size();
+				std::size_t length = std::min(block_size_, size - index * block_size_);
+				crc = crc32_combine(crc, block.crc, static_cast<z_off_t>(length));
+			}
+			detail::put_le32(out, static_cast<std::uint32_t>(crc));
+			detail::put_le32(out + 4, static_cast<std::uint32_t>(size & 0xFFFFFFFFu));
+		}
+	};
+
+	inline std::string compress_parallel(
+		const char* data,
+		std::size_t size,
+		int level = Z_DEFAULT_COMPRESSION,
+		std::size_t threads = 0) {
+		ParallelCompressor comp(level, threads);
+		std::string output;
+		comp.compress(output, data, size);
+		return output;
+	}
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef GZIP_PARALLEL_DECOMPRESS_HPP_INCLUDED
+#define GZIP_PARALLEL_DECOMPRESS_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/index.hpp>
+#include <gzip/output.hpp>
+#include <gzip/parallel.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	// Decompresses indexed gzip data on several cores. Every checkpoint of the index starts
+	// an independent segment that ends at the next checkpoint; segments are inflated
+	// concurrently, each restored from its checkpoint like IndexedDecompressor does, and
+	// written straight into their own region of one preallocated output. The index span
+	// sets the unit of work, so build it with a span well below size / threads.
+	class ParallelDecompressor {
+		std::size_t max_;
+		std::size_t threads_;
+		Executor* executor_;
+
+	  public:
+		ParallelDecompressor(std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+							 std::size_t max_bytes = 1000000000, // by default refuse operation if uncompressed data is > 1GB
+							 Executor* executor = nullptr) :
+			max_(max_bytes),
+			threads_(threads),
+			executor_(executor) {
+		}
+
+		template <typename OutputType>
+		void decompress(OutputType& output,
+						const char* data,
+						std::size_t size,
+						Index const& index) const
+		{
+			if (index.uncompressed_size() > max_) {
+				throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+			}
+			OutputTraits<OutputType>::resize(output, index.uncompressed_size());
+			if (index.uncompressed_size() > 0) {
+				decompress_into(OutputTraits<OutputType>::data(output), index.uncompressed_size(), data, size, index);
+			}
+		}
+
+		// Writes the whole uncompressed data into caller memory, e.g. a memory mapped output
+		// file. capacity must be at least index.uncompressed_size(); max_bytes does not apply.
+		void decompress_into(char* output,
+							 std::size_t capacity,
+							 const char* data,
+							 std::size_t size,
+							 Index const& index) const
+		{
+			if (size != index.compressed_size()) {
+				throw std::runtime_error("gzip index does not match the compressed data");
+			}
+			if (capacity < index.uncompressed_size()) {
+				throw std::runtime_error("output buffer is too small for the uncompressed data");
+			}
+
+			std::vector<Checkpoint> const& points = index.checkpoints();
+			std::size_t count = points.size();
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			detail::parallel_for(count, workers, [&](std::size_t, std::size_t segment) {
+				std::size_t begin = points[segment].uncompressed_offset;
+				std::size_t end = segment + 1 < count ? points[segment + 1].uncompressed_offset : index.uncompressed_size();
+				std::size_t produced = detail::inflate_from(detail::local_inflate_stream(-15), nullptr, data, size, points[segment],
+															0, output + begin, end - begin);
+				if (produced != end - begin) {
+					throw std::runtime_error("gzip index does not match the compressed data");
+				}
+			}, executor_);
+		}
+	};
+
+	inline std::string decompress_parallel(
+		const char* data,
+		std::size_t size,
+		Index const& index,
+		std::size_t threads = 0) {
+		ParallelDecompressor decomp(threads);
+		std::string output;
+		decomp.decompress(output, data, size, index);
+		return output;
+	}
+
+} // namespace gzip
+
+#endif
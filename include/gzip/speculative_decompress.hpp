@@ -0,0 +1,578 @@
+#ifndef GZIP_SPECULATIVE_DECOMPRESS_HPP_INCLUDED
+#define GZIP_SPECULATIVE_DECOMPRESS_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/output.hpp>
+#include <gzip/parallel.hpp>
+#include <gzip/utils.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gzip {
+
+	namespace detail {
+
+		// Reads bits least significant first, the order deflate packs them in
+		class BitReader {
+			const unsigned char* data_;
+			std::size_t size_;
+			std::size_t pos_;
+
+		  public:
+			BitReader(const char* data, std::size_t size, std::size_t bit) :
+				data_(reinterpret_cast<const unsigned char*>(data)),
+				size_(size * 8),
+				pos_(bit) {
+			}
+
+			// Returns false instead of reading past the end of the data
+			bool read(unsigned int count, unsigned int& value) {
+				if (pos_ > size_ || count > size_ - pos_) {
+					return false;
+				}
+				value = 0;
+				for (unsigned int i = 0; i < count; ++i, ++pos_) {
+					value |= ((static_cast<unsigned int>(data_[pos_ >> 3]) >> (pos_ & 7)) & 1u) << i;
+				}
+				return true;
+			}
+		};
+
+		// Canonical Huffman code in the form used by zlib's contrib/puff: the number of codes
+		// of each length and the symbols ordered by code
+		struct Huffman {
+			short count[16];
+			short symbol[320];
+		};
+
+		// Returns 0 for a complete code, > 0 if incomplete and < 0 if over-subscribed
+		inline int huffman_construct(Huffman& h, const short* length, int n) {
+			std::fill(h.count, h.count + 16, static_cast<short>(0));
+			for (int symbol = 0; symbol < n; ++symbol) {
+				h.count[length[symbol]]++;
+			}
+			if (h.count[0] == n) {
+				return 0;
+			}
+			int left = 1;
+			for (int len = 1; len < 16; ++len) {
+				left <<= 1;
+				left -= h.count[len];
+				if (left < 0) {
+					return left;
+				}
+			}
+			short offs[16];
+			offs[1] = 0;
+			for (int len = 1; len < 15; ++len) {
+				offs[len + 1] = static_cast<short>(offs[len] + h.count[len]);
+			}
+			for (int symbol = 0; symbol < n; ++symbol) {
+				if (length[symbol] != 0) {
+					h.symbol[offs[length[symbol]]++] = static_cast<short>(symbol);
+				}
+			}
+			return left;
+		}
+
+		// Returns the decoded symbol or -1 for running out of data or an unused code
+		inline int huffman_decode(BitReader& in, Huffman const& h) {
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int len = 1; len < 16; ++len) {
+				unsigned int bit = 0;
+				if (!in.read(1, bit)) {
+					return -1;
+				}
+				code |= static_cast<int>(bit);
+				int count = h.count[len];
+				if (code - count < first) {
+					return h.symbol[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+
+		// Cheap filter for a plausible non-final dynamic Huffman block header at a bit offset.
+		// It decodes the code length code and the literal/length and distance code lengths and
+		// checks they form codes inflate would accept, which rejects almost every offset that
+		// is not a real block boundary.
+		inline bool is_dynamic_block(const char* data, std::size_t size, std::size_t bit) {
+			BitReader in(data, size, bit);
+			unsigned int value = 0;
+			// BFINAL = 0 and BTYPE = 2, read together as three bits
+			if (!in.read(3, value) || value != 4) {
+				return false;
+			}
+			unsigned int nlen = 0;
+			unsigned int ndist = 0;
+			unsigned int ncode = 0;
+			if (!in.read(5, nlen) || !in.read(5, ndist) || !in.read(4, ncode)) {
+				return false;
+			}
+			nlen += 257;
+			ndist += 1;
+			ncode += 4;
+			if (nlen > 286 || ndist > 30) {
+				return false;
+			}
+
+			static const short order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+			short lengths[320] = {0};
+			for (unsigned int index = 0; index < ncode; ++index) {
+				if (!in.read(3, value)) {
+					return false;
+				}
+				lengths[order[index]] = static_cast<short>(value);
+			}
+			Huffman code;
+			if (huffman_construct(code, lengths, 19) != 0) {
+				return false;
+			}
+
+			unsigned int index = 0;
+			while (index < nlen + ndist) {
+				int symbol = huffman_decode(in, code);
+				if (symbol < 0) {
+					return false;
+				}
+				if (symbol < 16) {
+					lengths[index++] = static_cast<short>(symbol);
+					continue;
+				}
+				short repeat_length = 0;
+				unsigned int repeat = 0;
+				if (symbol == 16) {
+					if (index == 0 || !in.read(2, repeat)) {
+						return false;
+					}
+					repeat_length = lengths[index - 1];
+					repeat += 3;
+				} else if (symbol == 17) {
+					if (!in.read(3, repeat)) {
+						return false;
+					}
+					repeat += 3;
+				} else {
+					if (!in.read(7, repeat)) {
+						return false;
+					}
+					repeat += 11;
+				}
+				if (index + repeat > nlen + ndist) {
+					return false;
+				}
+				while (repeat-- > 0) {
+					lengths[index++] = repeat_length;
+				}
+			}
+			// a block without an end-of-block code can not be real
+			if (lengths[256] == 0) {
+				return false;
+			}
+			// incomplete codes are only valid when they hold a single code
+			Huffman literals;
+			int err = huffman_construct(literals, lengths, static_cast<int>(nlen));
+			if (err < 0 || (err > 0 && static_cast<int>(nlen) - literals.count[0] != 1)) {
+				return false;
+			}
+			Huffman distances;
+			err = huffman_construct(distances, lengths + nlen, static_cast<int>(ndist));
+			if (err < 0 || (err > 0 && static_cast<int>(ndist) - distances.count[0] != 1)) {
+				return false;
+			}
+			return true;
+		}
+
+		// A chunk of the input decoded without knowing the 32Kb of output before it. The chunk
+		// is inflated twice with two different placeholder windows: bytes that come out the
+		// same both times are real data, bytes that differ are markers naming the window
+		// position they were copied from, to be filled in once that window is known.
+		struct SpeculativeChunk {
+			std::size_t begin_bit;
+			std::size_t end_bit;
+			std::string literal;
+			std::string shadow;
+			uLong crc;
+		};
+
+		// Placeholder windows: literal[j] and shadow[j] always differ and together encode j
+		inline std::string marker_window(bool shadow) {
+			std::string window(deflate_window_size, '\0');
+			for (std::size_t j = 0; j < deflate_window_size; ++j) {
+				std::size_t low = j & 0xFF;
+				window[j] = static_cast<char>(shadow ? (low + 1 + (j >> 8)) & 0xFF : low);
+			}
+			return window;
+		}
+
+		inline std::size_t bit_position(z_stream const& inflate_s, const char* data) {
+			return static_cast<std::size_t>(reinterpret_cast<const char*>(inflate_s.next_in) - data) * 8 -
+				   static_cast<std::size_t>(inflate_s.data_type & 7);
+		}
+
+		// Positions a freshly reset raw inflate stream at a bit offset
+		inline void seek_bit(z_stream& inflate_s, const char* data, std::size_t size, std::size_t bit) {
+			std::size_t byte = bit >> 3;
+			int shift = static_cast<int>(bit & 7);
+			if (shift > 0) {
+				inflatePrime(&inflate_s, 8 - shift, static_cast<std::uint8_t>(data[byte]) >> shift);
+				++byte;
+			}
+			inflate_s.next_in = reinterpret_cast<z_const Bytef*>(data + byte);
+			inflate_s.avail_in = static_cast<unsigned int>(std::min<std::size_t>(size - byte, std::numeric_limits<unsigned int>::max()));
+		}
+
+		// Takes up to size bytes out of the output budget shared by all chunks and returns how
+		// many it got
+		inline std::size_t take_budget(std::atomic<std::size_t>& budget, std::size_t size) {
+			std::size_t left = budget.load();
+			std::size_t taken = 0;
+			do {
+				taken = std::min(size, left);
+			} while (!budget.compare_exchange_weak(left, left - taken));
+			return taken;
+		}
+
+		// Inflates whole deflate blocks from begin_bit until the block boundary at end_bit, or
+		// to the end of the deflate stream when end_bit is 0. Returns false if the data does
+		// not decode or the boundary is overshot, i.e. one of the offsets is not a real boundary,
+		// and when the output outgrows what is left of budget.
+		inline bool inflate_blocks(z_stream& inflate_s,
+								   const char* data,
+								   std::size_t size,
+								   std::size_t begin_bit,
+								   std::size_t& end_bit,
+								   std::string const* window,
+								   std::string& output,
+								   std::atomic<std::size_t>& budget) {
+			inflateReset2(&inflate_s, -15);
+			seek_bit(inflate_s, data, size, begin_bit);
+			if (window) {
+				inflateSetDictionary(&inflate_s, reinterpret_cast<const Bytef*>(window->data()), static_cast<unsigned int>(window->size()));
+			}
+			std::size_t initial = take_budget(budget, 4 * ((end_bit > begin_bit ? end_bit - begin_bit : size * 8 - begin_bit) / 8) + 1024);
+			if (initial == 0) {
+				return false;
+			}
+			output.resize(initial);
+			std::size_t produced = 0;
+			inflate_s.avail_out = 0;
+			for (;;) {
+				if (inflate_s.avail_out == 0) {
+					if (produced == output.size()) {
+						std::size_t more = take_budget(budget, output.size());
+						if (more == 0) {
+							return false;
+						}
+						output.resize(output.size() + more);
+					}
+					inflate_s.next_out = reinterpret_cast<Bytef*>(&output[0] + produced);
+					inflate_s.avail_out = static_cast<unsigned int>(std::min<std::size_t>(output.size() - produced, std::numeric_limits<unsigned int>::max()));
+				}
+				if (inflate_s.avail_in == 0) {
+					std::size_t pos = static_cast<std::size_t>(reinterpret_cast<const char*>(inflate_s.next_in) - data);
+					inflate_s.avail_in = static_cast<unsigned int>(std::min<std::size_t>(size - pos, std::numeric_limits<unsigned int>::max()));
+				}
+				unsigned int avail_out = inflate_s.avail_out;
+				int ret = inflate(&inflate_s, Z_BLOCK);
+				produced += avail_out - inflate_s.avail_out;
+				if (ret == Z_STREAM_END) {
+					std::size_t pos = bit_position(inflate_s, data);
+					if (end_bit != 0 && pos != end_bit) {
+						return false;
+					}
+					end_bit = pos;
+					break;
+				}
+				if (ret != Z_OK) {
+					return false;
+				}
+				if ((inflate_s.data_type & 128) != 0 && end_bit != 0) {
+					std::size_t pos = bit_position(inflate_s, data);
+					if (pos >= end_bit) {
+						if (pos != end_bit) {
+							return false;
+						}
+						break;
+					}
+				}
+			}
+			output.resize(produced);
+			return true;
+		}
+
+		// Copies a speculatively decoded range to out, replacing markers with bytes of the
+		// output that preceded the chunk. Returns false for a marker outside that output.
+		inline bool resolve_markers(const char* literal,
+									const char* shadow,
+									std::size_t length,
+									std::string const& window,
+									char* out) {
+			std::size_t missing = deflate_window_size - window.size();
+			for (std::size_t k = 0; k < length; ++k) {
+				std::uint8_t low = static_cast<std::uint8_t>(literal[k]);
+				std::uint8_t other = static_cast<std::uint8_t>(shadow[k]);
+				if (low == other) {
+					out[k] = literal[k];
+					continue;
+				}
+				std::size_t high = static_cast<std::uint8_t>(other - low - 1);
+				std::size_t j = (high << 8) | low;
+				if (high >= (deflate_window_size >> 8) || j < missing) {
+					return false;
+				}
+				out[k] = window[j - missing];
+			}
+			return true;
+		}
+
+	} // namespace detail
+
+	// Multi-core decompression of ordinary single member gzip data without an index, in the
+	// manner of rapidgzip. The compressed input is cut into chunks; for each chunk a worker
+	// searches for the first dynamic Huffman block boundary and confirms it by inflating that
+	// block. Every chunk is then inflated from its boundary to the next one without knowing
+	// the output before it, leaving markers for the bytes copied from that unknown window.
+	// Once the chunks are decoded, the window at each boundary is known in order and the
+	// markers are replaced in parallel. The CRC32 and ISIZE of the trailer are checked.
+	//
+	// Input the speculation can not handle (multiple members, boundaries that are missed or
+	// wrongly guessed, chunks without a dynamic block) falls back to a serial Decompressor,
+	// so the output is always the same as gzip::decompress; only the speed differs.
+	class SpeculativeDecompressor {
+		std::size_t max_;
+		std::size_t threads_;
+		std::size_t chunk_size_;
+		Executor* executor_;
+
+		bool find_boundary(z_stream& inflate_s,
+						   std::string const& zeros,
+						   std::string& scratch,
+						   const char* data,
+						   std::size_t size,
+						   std::size_t begin_bit,
+						   std::size_t end_bit,
+						   std::size_t& found) const {
+			for (std::size_t bit = begin_bit; bit < end_bit; ++bit) {
+				if (!detail::is_dynamic_block(data, size, bit)) {
+					continue;
+				}
+				// confirm the candidate by inflating its first block with a placeholder window
+				inflateReset2(&inflate_s, -15);
+				detail::seek_bit(inflate_s, data, size, bit);
+				inflateSetDictionary(&inflate_s, reinterpret_cast<const Bytef*>(zeros.data()), static_cast<unsigned int>(zeros.size()));
+				int ret = Z_OK;
+				do {
+					inflate_s.next_out = reinterpret_cast<Bytef*>(&scratch[0]);
+					inflate_s.avail_out = static_cast<unsigned int>(scratch.size());
+					ret = inflate(&inflate_s, Z_BLOCK);
+				} while (ret == Z_OK && (inflate_s.data_type & 128) == 0);
+				if (ret == Z_OK) {
+					found = bit;
+					return true;
+				}
+			}
+			return false;
+		}
+
+	  public:
+		// chunk_size is in compressed bytes and should stay well above the typical deflate
+		// block size of a few tens of Kb.
+		SpeculativeDecompressor(std::size_t threads = 0, // 0 picks the worker count, see detail::worker_count
+								std::size_t chunk_size = 4 * 1024 * 1024,
+								std::size_t max_bytes = 1000000000, // by default refuse operation if uncompressed data is > 1GB
+								Executor* executor = nullptr) :
+			max_(max_bytes),
+			threads_(threads),
+			chunk_size_(std::max<std::size_t>(chunk_size, 64 * 1024)),
+			executor_(executor) {
+		}
+
+		// Returns true when the input was decoded in parallel, false when it was decoded serially
+		template <typename OutputType>
+		bool decompress(OutputType& output,
+						const char* data,
+						std::size_t size) const
+		{
+			if (speculate(output, data, size)) {
+				return true;
+			}
+			Decompressor(max_).decompress(output, data, size);
+			return false;
+		}
+
+	  private:
+		template <typename OutputType>
+		bool speculate(OutputType& output,
+					   const char* data,
+					   std::size_t size) const
+		{
+			if (size <= detail::gzip_header_size + detail::gzip_trailer_size || !detail::is_gzip_member(data, size)) {
+				return false;
+			}
+
+			// let zlib parse the header, Z_BLOCK stops right before the first deflate block
+			detail::InflateStreamPtr header_s = detail::make_inflate_stream(15 + 16);
+			header_s->next_in = reinterpret_cast<z_const Bytef*>(data);
+			header_s->avail_in = static_cast<unsigned int>(std::min<std::size_t>(size, std::numeric_limits<unsigned int>::max()));
+			char byte = 0;
+			header_s->next_out = reinterpret_cast<Bytef*>(&byte);
+			header_s->avail_out = 1;
+			if (inflate(header_s.get(), Z_BLOCK) != Z_OK || (header_s->data_type & 128) == 0) {
+				return false;
+			}
+			std::size_t start = static_cast<std::size_t>(reinterpret_cast<const char*>(header_s->next_in) - data);
+
+			std::size_t count = std::max<std::size_t>((size - start) / chunk_size_, 1);
+			std::size_t workers = detail::worker_count(threads_, count, executor_);
+			if (count == 1) {
+				return false;
+			}
+
+			// 1. find a block boundary in every chunk but the first
+			std::string const zeros(detail::deflate_window_size, '\0');
+			std::vector<std::size_t> found(count, 0);
+			std::vector<char> has_boundary(count, 0);
+			has_boundary[0] = 1;
+			found[0] = start * 8;
+			detail::parallel_for(count - 1, workers, [&](std::size_t, std::size_t index) {
+				std::size_t chunk = index + 1;
+				std::size_t begin = (start + chunk * chunk_size_) * 8;
+				std::size_t end = chunk + 1 < count ? (start + (chunk + 1) * chunk_size_) * 8 : size * 8;
+				std::string scratch(64 * 1024, '\0');
+				has_boundary[chunk] = find_boundary(detail::local_inflate_stream(-15), zeros, scratch, data, size, begin, end, found[chunk]) ? 1 : 0;
+			}, executor_);
+
+			std::vector<detail::SpeculativeChunk> chunks;
+			for (std::size_t chunk = 0; chunk < count; ++chunk) {
+				if (has_boundary[chunk]) {
+					detail::SpeculativeChunk next = {found[chunk], 0, std::string(), std::string(), 0};
+					if (!chunks.empty()) {
+						chunks.back().end_bit = found[chunk];
+					}
+					chunks.push_back(std::move(next));
+				}
+			}
+			if (chunks.size() == 1) {
+				return false;
+			}
+
+			// 2. inflate every chunk, the later ones twice against the two placeholder windows
+			std::string const literal_window = detail::marker_window(false);
+			std::string const shadow_window = detail::marker_window(true);
+			// All chunk output, both copies of it, stays within max_bytes. Once it does not fit,
+			// the serial decoder takes over and enforces the limit on the real output.
+			std::atomic<std::size_t> budget(max_);
+			std::vector<char> ok(chunks.size(), 0);
+			detail::parallel_for(chunks.size(), workers, [&](std::size_t, std::size_t index) {
+				detail::SpeculativeChunk& chunk = chunks[index];
+				z_stream& inflate_s = detail::local_inflate_stream(-15);
+				std::size_t end_bit = chunk.end_bit;
+				bool decoded = false;
+				if (index == 0) {
+					decoded = detail::inflate_blocks(inflate_s, data, size, chunk.begin_bit, end_bit, nullptr, chunk.literal, budget);
+				} else {
+					decoded = detail::inflate_blocks(inflate_s, data, size, chunk.begin_bit, end_bit, &literal_window, chunk.literal, budget) &&
+							  detail::inflate_blocks(inflate_s, data, size, chunk.begin_bit, end_bit, &shadow_window, chunk.shadow, budget) &&
+							  chunk.literal.size() == chunk.shadow.size();
+				}
+				ok[index] = decoded ? 1 : 0;
+				chunk.end_bit = end_bit;
+			}, executor_);
+			if (std::find(ok.begin(), ok.end(), 0) != ok.end()) {
+				return false;
+			}
+
+			// 3. walk the chunks in order to learn the window in front of each one
+			std::vector<std::size_t> offsets(chunks.size() + 1, 0);
+			std::vector<std::string> windows(chunks.size());
+			for (std::size_t index = 0; index < chunks.size(); ++index) {
+				detail::SpeculativeChunk const& chunk = chunks[index];
+				offsets[index + 1] = offsets[index] + chunk.literal.size();
+				if (offsets[index + 1] > max_) {
+					throw std::runtime_error("size of output string will use more memory then intended when decompressing");
+				}
+				if (index + 1 == chunks.size()) {
+					break;
+				}
+				std::size_t tail = std::min(chunk.literal.size(), detail::deflate_window_size);
+				std::string window = windows[index];
+				std::size_t from = window.size();
+				window.resize(from + tail);
+				std::size_t at = chunk.literal.size() - tail;
+				if (index == 0) {
+					std::memcpy(&window[from], chunk.literal.data() + at, tail);
+				} else if (tail > 0 && !detail::resolve_markers(chunk.literal.data() + at, chunk.shadow.data() + at, tail, windows[index], &window[from])) {
+					return false;
+				}
+				windows[index + 1] = window.substr(window.size() - std::min(window.size(), detail::deflate_window_size));
+			}
+
+			// 4. fill in the markers of all chunks concurrently
+			OutputTraits<OutputType>::resize(output, offsets.back());
+			char* base = offsets.back() > 0 ? OutputTraits<OutputType>::data(output) : nullptr;
+			std::vector<char> resolved(chunks.size(), 0);
+			detail::parallel_for(chunks.size(), workers, [&](std::size_t, std::size_t index) {
+				detail::SpeculativeChunk& chunk = chunks[index];
+				char* out = base ? base + offsets[index] : nullptr;
+				if (index == 0) {
+					if (!chunk.literal.empty()) {
+						std::memcpy(out, chunk.literal.data(), chunk.literal.size());
+					}
+					resolved[index] = 1;
+				} else {
+					resolved[index] = detail::resolve_markers(chunk.literal.data(), chunk.shadow.data(), chunk.literal.size(), windows[index], out) ? 1 : 0;
+				}
+				chunk.crc = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(out), static_cast<unsigned int>(chunk.literal.size()));
+				std::string().swap(chunk.literal);
+				std::string().swap(chunk.shadow);
+			}, executor_);
+			if (std::find(resolved.begin(), resolved.end(), 0) != resolved.end()) {
+				return false;
+			}
+
+			// 5. the deflate stream must end right before the trailer that closes the input
+			std::size_t end = (chunks.back().end_bit + 7) / 8;
+			if (end + detail::gzip_trailer_size != size) {
+				return false;
+			}
+			uLong crc = crc32(0L, Z_NULL, 0);
+			for (std::size_t index = 0; index < chunks.size(); ++index) {
+				crc = crc32_combine(crc, chunks[index].crc, static_cast<z_off_t>(offsets[index + 1] - offsets[index]));
+			}
+			return detail::get_le32(data + end) == static_cast<std::uint32_t>(crc) &&
+				   detail::get_le32(data + end + 4) == static_cast<std::uint32_t>(offsets.back() & 0xFFFFFFFFu);
+		}
+	};
+
+	inline std::string decompress_speculative(
+		const char* data,
+		std::size_t size,
+		std::size_t threads = 0) {
+		SpeculativeDecompressor decomp(threads);
+		std::string output;
+		decomp.decompress(output, data, size);
+		return output;
+	}
+
+} // namespace gzip
+
+#endif
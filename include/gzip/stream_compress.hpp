@@ -0,0 +1,153 @@
+#ifndef GZIP_STREAM_COMPRESS_HPP_INCLUDED
+#define GZIP_STREAM_COMPRESS_HPP_INCLUDED
+
+#include <gzip/compress.hpp>
+#include <gzip/config.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace gzip {
+
+	// Push based gzip compression. Input is fed in pieces through write() and compressed
+	// output is handed to the sink one chunk at a time as deflate produces it, so memory
+	// stays at the deflate state plus one output chunk no matter how large the payload is.
+	//
+	// The stream uses the same deflateInit2 configuration as Compressor. finish() ends the
+	// gzip member; a write() after that starts a new member on the same deflate state.
+	// Without a write since the last finish(), flush() and finish() emit nothing, while
+	// finish() on a stream never written to emits one empty member.
+	// The destructor does not finish the member, call finish() before dropping the stream.
+	class StreamCompressor {
+	  public:
+		using Sink = std::function<void(const char* data, std::size_t size)>;
+
+	  private:
+		Sink sink_;
+		int level_;
+		std::size_t chunk_size_;
+		std::unique_ptr<char[]> chunk_;
+		detail::DeflateStreamPtr deflate_s_;
+		bool in_member_;
+		bool finished_; // a member was finished and nothing was written since
+
+		void begin_member() {
+			if (in_member_) {
+				return;
+			}
+			if (deflate_s_) {
+				deflateReset(deflate_s_.get());
+			} else {
+				deflate_s_ = detail::make_deflate_stream(level_);
+				chunk_.reset(new char[chunk_size_]);
+			}
+			deflate_s_->next_out = reinterpret_cast<Bytef*>(chunk_.get());
+			deflate_s_->avail_out = static_cast<unsigned int>(chunk_size_);
+			in_member_ = true;
+		}
+
+		void emit() {
+			std::size_t have = chunk_size_ - deflate_s_->avail_out;
+			if (have > 0) {
+				sink_(chunk_.get(), have);
+			}
+			deflate_s_->next_out = reinterpret_cast<Bytef*>(chunk_.get());
+			deflate_s_->avail_out = static_cast<unsigned int>(chunk_size_);
+		}
+
+		// Runs deflate over whatever is in next_in. With Z_NO_FLUSH only full chunks are
+		// emitted and the remainder stays buffered, otherwise everything is drained to the sink.
+		void run(int flush) {
+			for (;;) {
+				int ret = deflate(deflate_s_.get(), flush);
+				// Z_BUF_ERROR only means no progress was possible, e.g. flushing twice in a row
+				if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+					throw std::runtime_error("deflate failed");
+				}
+				bool full = deflate_s_->avail_out == 0;
+				if (full) {
+					emit();
+				}
+				if (flush == Z_NO_FLUSH) {
+					if (deflate_s_->avail_in == 0) {
+						return;
+					}
+				} else if (flush == Z_FINISH) {
+					if (ret == Z_STREAM_END) {
+						emit();
+						return;
+					}
+				} else if (!full) {
+					emit();
+					return;
+				}
+			}
+		}
+
+	  public:
+		StreamCompressor(Sink sink,
+						 int level = Z_DEFAULT_COMPRESSION,
+						 std::size_t chunk_size = 16384) :
+			sink_(std::move(sink)),
+			level_(level),
+			chunk_size_(std::min<std::size_t>(std::max<std::size_t>(chunk_size, 64), std::numeric_limits<unsigned int>::max())),
+			in_member_(false),
+			finished_(false) {
+		}
+
+		StreamCompressor(StreamCompressor&&) = default;
+		StreamCompressor& operator=(StreamCompressor&&) = default;
+		StreamCompressor(const StreamCompressor&) = delete;
+		StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+		void write(const char* data, std::size_t size) {
+			begin_member();
+			// avail_in is an unsigned int, so very large writes are fed in pieces
+			while (size > 0) {
+				unsigned int piece = static_cast<unsigned int>(std::min<std::size_t>(size, std::numeric_limits<unsigned int>::max()));
+				deflate_s_->next_in = reinterpret_cast<z_const Bytef*>(data);
+				deflate_s_->avail_in = piece;
+				run(Z_NO_FLUSH);
+				data += piece;
+				size -= piece;
+			}
+		}
+
+		void write(std::string const& data) {
+			write(data.data(), data.size());
+		}
+
+		// Emits all pending output ending on a byte boundary (Z_SYNC_FLUSH), so a reader can
+		// decode everything written so far. Frequent flushes hurt the compression ratio.
+		void flush() {
+			if (!in_member_) {
+				return;
+			}
+			deflate_s_->avail_in = 0;
+			run(Z_SYNC_FLUSH);
+		}
+
+		// Ends the gzip member and emits the remaining output including the trailer
+		void finish() {
+			if (!in_member_ && finished_) {
+				return;
+			}
+			begin_member();
+			deflate_s_->avail_in = 0;
+			run(Z_FINISH);
+			in_member_ = false;
+			finished_ = true;
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef GZIP_STREAM_DECOMPRESS_HPP_INCLUDED
+#define GZIP_STREAM_DECOMPRESS_HPP_INCLUDED
+
+#include <gzip/config.hpp>
+#include <gzip/decompress.hpp>
+
+// zlib
+#include <zlib.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace gzip {
+
+	// Push based gzip/zlib decompression. Compressed input is fed in pieces as it arrives
+	// through write() and decompressed output is handed to the sink in chunks of exactly
+	// chunk_size bytes, except for the last chunk of the stream or one forced by flush().
+	// Memory stays at the inflate state plus one output chunk whatever the payload size.
+	//
+	// max_bytes is a running limit on the total output: it is checked before every chunk is
+	// handed to the sink and an exception is thrown as soon as the stream would exceed it.
+	// Concatenated gzip members (cat a.gz b.gz) decode as one stream, like Decompressor does.
+	// Other input following the end of the compressed stream is ignored until finish() is
+	// called; the next write() after finish() starts decoding a new stream.
+	class StreamDecompressor {
+	  public:
+		using Sink = std::function<void(const char* data, std::size_t size)>;
+
+	  private:
+		Sink sink_;
+		std::size_t max_;
+		std::size_t chunk_size_;
+		std::size_t total_out_;
+		std::unique_ptr<char[]> chunk_;
+		detail::InflateStreamPtr inflate_s_;
+		// filled in by inflate, tells a finished gzip member from a zlib stream
+		std::unique_ptr<gz_header> header_;
+		bool in_stream_;
+		bool done_;
+		bool magic_; // the last write ended on what may be the first byte of another member
+
+		void begin_stream() {
+			if (in_stream_) {
+				return;
+			}
+			if (inflate_s_) {
+				inflateReset2(inflate_s_.get(), detail::inflate_window_bits);
+			} else {
+				inflate_s_ = detail::make_inflate_stream();
+				chunk_.reset(new char[chunk_size_]);
+				header_.reset(new gz_header());
+			}
+			inflateGetHeader(inflate_s_.get(), header_.get());
+			inflate_s_->next_out = reinterpret_cast<Bytef*>(chunk_.get());
+			inflate_s_->avail_out = static_cast<unsigned int>(chunk_size_);
+			total_out_ = 0;
+			in_stream_ = true;
+			done_ = false;
+			magic_ = false;
+		}
+
+		// After a gzip member, starts decoding the next one if the pending input begins with
+		// one. Returns false while there is none, and for good once other bytes follow.
+		bool next_member() {
+			if (header_->done != 1) {
+				return false;
+			}
+			z_const Bytef* next_in = inflate_s_->next_in;
+			unsigned int avail_in = inflate_s_->avail_in;
+			if (avail_in == 0) {
+				return false;
+			}
+			bool starts = magic_ ? static_cast<std::uint8_t>(next_in[0]) == 0x8B
+								 : detail::is_gzip_member(reinterpret_cast<const char*>(next_in), avail_in);
+			if (!starts && !magic_ && avail_in == 1 && static_cast<std::uint8_t>(next_in[0]) == 0x1F) {
+				// the magic bytes are split across writes
+				magic_ = true;
+				inflate_s_->next_in += 1;
+				inflate_s_->avail_in = 0;
+				return false;
+			}
+			if (!starts) {
+				header_->done = 0;
+				return false;
+			}
+			inflateReset(inflate_s_.get());
+			inflateGetHeader(inflate_s_.get(), header_.get());
+			if (magic_) {
+				// feed inflate the first magic byte, consumed by the previous write
+				static const Bytef first = 0x1F;
+				inflate_s_->next_in = const_cast<z_const Bytef*>(&first);
+				inflate_s_->avail_in = 1;
+				inflate(inflate_s_.get(), Z_NO_FLUSH);
+				inflate_s_->next_in = next_in;
+				inflate_s_->avail_in = avail_in;
+				magic_ = false;
+			}
+			done_ = false;
+			return true;
+		}
+
+		void emit() {
+			std::size_t have = chunk_size_ - inflate_s_->avail_out;
+			if (have > 0) {
+				if (have > max_ - total_out_) {
+					throw std::runtime_error("size of output will use more memory then intended when decompressing");
+				}
+				total_out_ += have;
+				sink_(chunk_.get(), have);
+			}
+			inflate_s_->next_out = reinterpret_cast<Bytef*>(chunk_.get());
+			inflate_s_->avail_out = static_cast<unsigned int>(chunk_size_);
+		}
+
+		void run() {
+			for (;;) {
+				if (done_ && !next_member()) {
+					return;
+				}
+				int ret = inflate(inflate_s_.get(), Z_NO_FLUSH);
+				if (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR) {
+					throw std::runtime_error(inflate_s_->msg != Z_NULL ? inflate_s_->msg : "inflate failed");
+				}
+				bool full = inflate_s_->avail_out == 0;
+				if (full) {
+					emit();
+				}
+				if (ret == Z_STREAM_END) {
+					emit();
+					done_ = true;
+				} else if (!full && inflate_s_->avail_in == 0) {
+					// all input consumed and inflate has no pending output left
+					return;
+				}
+			}
+		}
+
+	  public:
+		StreamDecompressor(Sink sink,
+						   std::size_t max_bytes = 1000000000, // by default refuse operation if uncompressed data is > 1GB
+						   std::size_t chunk_size = 65536) :
+			sink_(std::move(sink)),
+			max_(max_bytes),
+			chunk_size_(std::min<std::size_t>(std::max<std::size_t>(chunk_size, 1), std::numeric_limits<unsigned int>::max())),
+			total_out_(0),
+			in_stream_(false),
+			done_(false),
+			magic_(false) {
+		}
+
+		StreamDecompressor(StreamDecompressor&&) = default;
+		StreamDecompressor& operator=(StreamDecompressor&&) = default;
+		StreamDecompressor(const StreamDecompressor&) = delete;
+		StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+		void write(const char* data, std::size_t size) {
+			begin_stream();
+			// avail_in is an unsigned int, so very large writes are fed in pieces
+			while (size > 0) {
+				unsigned int piece = static_cast<unsigned int>(std::min<std::size_t>(size, std::numeric_limits<unsigned int>::max()));
+				inflate_s_->next_in = reinterpret_cast<z_const Bytef*>(data);
+				inflate_s_->avail_in = piece;
+				run();
+				data += piece;
+				size -= piece;
+			}
+		}
+
+		void write(std::string const& data) {
+			write(data.data(), data.size());
+		}
+
+		// Hands the partially filled output chunk to the sink without waiting for it to fill up
+		void flush() {
+			if (in_stream_) {
+				emit();
+			}
+		}
+
+		// Emits the remaining output and checks the compressed stream is complete
+		void finish() {
+			begin_stream();
+			emit();
+			in_stream_ = false;
+			if (!done_) {
+				throw std::runtime_error("compressed stream is truncated");
+			}
+		}
+
+		// Drops the current stream, e.g. after an exception, so the next write() starts a new one
+		void reset() {
+			in_stream_ = false;
+		}
+
+		// True once the end of the compressed stream, or of its last gzip member so far, has been decoded
+		bool done() const {
+			return done_;
+		}
+
+		// Bytes handed to the sink for the current stream
+		std::size_t total_out() const {
+			return total_out_;
+		}
+	};
+
+} // namespace gzip
+
+#endif
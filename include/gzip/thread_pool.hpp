@@ -0,0 +1,203 @@
+#ifndef GZIP_THREAD_POOL_HPP_INCLUDED
+#define GZIP_THREAD_POOL_HPP_INCLUDED
+
+#include <gzip/parallel.hpp>
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace gzip {
+
+	// A small work-stealing pool to share between the parallel compressors and decompressors.
+	// Every worker has its own task queue: tasks submitted from a worker go to the back of
+	// its queue and are taken back in LIFO order, tasks submitted from outside are spread
+	// round robin, and an idle worker steals from the front of the other queues.
+	//
+	// Workers live as long as the pool, so the deflate and inflate streams the library caches
+	// per thread (one of each per worker) are allocated once and reused by every later call.
+	class ThreadPool : public Executor {
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues_;
+		std::vector<std::thread> threads_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::condition_variable idle_;
+		std::size_t queued_;
+		std::size_t pending_;
+		std::size_t next_queue_;
+		std::exception_ptr error_;
+		bool stop_;
+
+		// Index of the calling thread in this pool, or the number of workers for other threads
+		std::size_t self() const {
+			return current() == this ? current_index() : queues_.size();
+		}
+
+		static ThreadPool const*& current() {
+			static thread_local ThreadPool const* pool = nullptr;
+			return pool;
+		}
+
+		static std::size_t& current_index() {
+			static thread_local std::size_t index = 0;
+			return index;
+		}
+
+		bool take(std::size_t worker, std::function<void()>& task) {
+			std::size_t count = queues_.size();
+			for (std::size_t i = 0; i < count; ++i) {
+				Queue& queue = *queues_[(worker + i) % count];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.tasks.empty()) {
+					continue;
+				}
+				if (i == 0) {
+					task = std::move(queue.tasks.back());
+					queue.tasks.pop_back();
+				} else {
+					task = std::move(queue.tasks.front());
+					queue.tasks.pop_front();
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void run(std::size_t worker) {
+			current() = this;
+			current_index() = worker;
+			for (;;) {
+				std::function<void()> task;
+				if (take(worker, task)) {
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						--queued_;
+					}
+					try {
+						task();
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(mutex_);
+						if (!error_) {
+							error_ = std::current_exception();
+						}
+					}
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (--pending_ == 0) {
+						idle_.notify_all();
+					}
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mutex_);
+				if (stop_ && queued_ == 0) {
+					return;
+				}
+				wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+			}
+		}
+
+		static void pin(std::thread& thread, std::size_t worker) {
+#ifdef __linux__
+			std::size_t cpus = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(worker % cpus, &set);
+			// best effort: a restricted cpuset only means the worker is not pinned
+			pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+			(void)thread;
+			(void)worker;
+#endif
+		}
+
+	  public:
+		// threads = 0 starts one worker per hardware thread. With pin_threads set, worker i is
+		// bound to CPU i (modulo the CPU count) on Linux; elsewhere the flag is ignored.
+		explicit ThreadPool(std::size_t threads = 0, bool pin_threads = false) :
+			queued_(0),
+			pending_(0),
+			next_queue_(0),
+			stop_(false) {
+			threads = threads == 0 ? detail::default_concurrency() : threads;
+			for (std::size_t worker = 0; worker < threads; ++worker) {
+				queues_.emplace_back(new Queue);
+			}
+			threads_.reserve(threads);
+			for (std::size_t worker = 0; worker < threads; ++worker) {
+				threads_.emplace_back(&ThreadPool::run, this, worker);
+				if (pin_threads) {
+					pin(threads_.back(), worker);
+				}
+			}
+		}
+
+		// Runs the queued tasks to completion, then stops the workers
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			wake_.notify_all();
+			for (auto& thread : threads_) {
+				thread.join();
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		std::size_t concurrency() const override {
+			return threads_.size();
+		}
+
+		void submit(std::function<void()> task) override {
+			std::size_t worker = self();
+			{
+				// counted before the task is visible: a nested task stolen and finished by
+				// another worker must not bring pending_ to 0 while its parent still runs
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (worker == queues_.size()) {
+					worker = next_queue_++ % queues_.size();
+				}
+				++queued_;
+				++pending_;
+			}
+			{
+				std::lock_guard<std::mutex> lock(queues_[worker]->mutex);
+				queues_[worker]->tasks.push_back(std::move(task));
+			}
+			wake_.notify_one();
+		}
+
+		// Blocks until every submitted task has finished, then rethrows the first exception a
+		// task threw, if any. Must not be called from inside a task of the same pool.
+		void wait() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			idle_.wait(lock, [this] { return pending_ == 0; });
+			if (error_) {
+				std::exception_ptr error = error_;
+				error_ = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+	};
+
+} // namespace gzip
+
+#endif
@@ -1,10 +1,60 @@
 #ifndef GZIP_UTILIS_HPP_INCLUDED
 #define GZIP_UTILIS_HPP_INCLUDED
 
+#include <cstdint>
 #include <cstdlib>
 
 namespace gzip {
 
+	namespace detail {
+
+		// Largest distance a deflate back reference can reach, i.e. the useful dictionary size
+		constexpr std::size_t deflate_window_size = 32768;
+
+		// deflate never decodes to more than about 1032 times its size: a 258 byte match
+		// costs at least 2 bits. Caps how far an untrusted size field can be believed.
+		constexpr std::size_t max_inflate_ratio = 1032;
+
+		constexpr std::size_t gzip_header_size = 10;
+		constexpr std::size_t gzip_trailer_size = 8;
+
+		// big endian, as used by the zlib header and trailer
+		inline std::uint32_t get_be32(const char* in) {
+			return static_cast<std::uint32_t>(static_cast<uint8_t>(in[0])) << 24 |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[1])) << 16 |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[2])) << 8 |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[3]));
+		}
+
+		inline std::uint32_t get_le32(const char* in) {
+			return static_cast<std::uint32_t>(static_cast<uint8_t>(in[0])) |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[1])) << 8 |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[2])) << 16 |
+				   static_cast<std::uint32_t>(static_cast<uint8_t>(in[3])) << 24;
+		}
+
+		inline void put_le32(char* out, std::uint32_t value) {
+			out[0] = static_cast<char>(value & 0xFF);
+			out[1] = static_cast<char>((value >> 8) & 0xFF);
+			out[2] = static_cast<char>((value >> 16) & 0xFF);
+			out[3] = static_cast<char>((value >> 24) & 0xFF);
+		}
+
+		inline std::uint64_t get_le64(const char* in) {
+			return static_cast<std::uint64_t>(get_le32(in)) | static_cast<std::uint64_t>(get_le32(in + 4)) << 32;
+		}
+
+		inline void put_le64(char* out, std::uint64_t value) {
+			put_le32(out, static_cast<std::uint32_t>(value & 0xFFFFFFFFu));
+			put_le32(out + 4, static_cast<std::uint32_t>(value >> 32));
+		}
+
+		inline bool is_gzip_member(const char* data, std::size_t size) {
+			return size >= 2 && static_cast<uint8_t>(data[0]) == 0x1F && static_cast<uint8_t>(data[1]) == 0x8B;
+		}
+
+	} // namespace detail
+
 	// These live in gzip.hpp because it doesnt need to use deps.
 	// Otherwise, they would need to live in impl files if these methods used
 	// zlib structures or functions like inflate/deflate)
@@ -21,6 +71,18 @@ namespace gzip {
 				   // gzip
 				   (static_cast<uint8_t>(data[0]) == 0x1F && static_cast<uint8_t>(data[1]) == 0x8B));
 	}
+
+	// Reads ISIZE, the last four bytes of a gzip member, which hold the uncompressed size modulo 2^32.
+	// Returns false if the data does not look like gzip or is too short to hold a header and trailer.
+	// For multi-member or corrupt input the value is wrong, so only treat it as a hint.
+	inline bool read_isize(const char* data, std::size_t size, std::uint32_t& isize) {
+		// 10 byte header, at least 2 bytes of deflate data, 8 byte trailer
+		if (size < 20 || !detail::is_gzip_member(data, size)) {
+			return false;
+		}
+		isize = detail::get_le32(data + size - 4);
+		return true;
+	}
 } // namespace gzip
 
 #endif
\ No newline at end of file
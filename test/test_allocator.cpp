@@ -0,0 +1,139 @@
+#include <catch.hpp>
+#include <gzip/allocator.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/dictionary.hpp>
+#include "test_data.hpp"
+
+#include <thread>
+
+TEST_CASE("allocator - arena rewinds once its streams are released")
+{
+    std::string data = make_text(100000, 5);
+    gzip::ArenaAllocator arena;
+    CHECK(arena.capacity() == 0);
+
+    std::string compressed;
+    {
+        gzip::Compressor comp(Z_DEFAULT_COMPRESSION, 2000000000, &arena);
+        comp.compress(compressed, data.data(), data.size());
+        CHECK(arena.used() > 0);
+        // the stream is kept between calls, so the arena is not touched again
+        std::size_t used = arena.used();
+        comp.compress(compressed, data.data(), data.size());
+        CHECK(arena.used() == used);
+    }
+    CHECK(arena.used() == 0);
+    std::size_t capacity = arena.capacity();
+    CHECK(capacity > 0);
+    CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+
+    // the next stream fits into the grown block
+    {
+        gzip::Compressor comp(Z_DEFAULT_COMPRESSION, 2000000000, &arena);
+        std::string again;
+        comp.compress(again, data.data(), data.size());
+        CHECK(again == compressed);
+    }
+    CHECK(arena.capacity() == capacity);
+
+    {
+        gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::geometric(), &arena);
+        std::string output;
+        decomp.decompress(output, compressed.data(), compressed.size());
+        CHECK(output == data);
+    }
+    CHECK(arena.used() == 0);
+    CHECK(arena.capacity() == capacity);
+}
+
+TEST_CASE("allocator - dictionary compressor allocates from the arena once")
+{
+    std::string data = make_text(20000, 5);
+    gzip::Dictionary dictionary(make_text(4000, 6));
+    gzip::ArenaAllocator arena;
+    std::string expected = [&] {
+        std::string compressed;
+        gzip::Compressor(dictionary).compress(compressed, data.data(), data.size());
+        return compressed;
+    }();
+    {
+        gzip::Compressor comp(dictionary, gzip::DictionaryFraming::zlib, 6, 2000000000, &arena);
+        std::string compressed;
+        comp.compress(compressed, data.data(), data.size());
+        std::size_t used = arena.used();
+        CHECK(used > 0);
+        for (int i = 0; i < 50; ++i)
+        {
+            comp.compress(compressed, data.data(), data.size());
+        }
+        CHECK(arena.used() == used);
+        CHECK(compressed == expected);
+    }
+    CHECK(arena.used() == 0);
+}
+
+TEST_CASE("allocator - slab pool serves deflate streams")
+{
+    std::string data = make_text(200000, 5);
+    std::string expected = gzip::compress(data.data(), data.size());
+    gzip::SlabPool pool(2);
+
+    for (int round = 0; round < 3; ++round)
+    {
+        gzip::Compressor first(Z_DEFAULT_COMPRESSION, 2000000000, &pool);
+        gzip::Compressor second(Z_BEST_SPEED, 2000000000, &pool);
+        std::string output;
+        first.compress(output, data.data(), data.size());
+        CHECK(output == expected);
+        second.compress(output, data.data(), data.size());
+        CHECK(gzip::decompress(output.data(), output.size()) == data);
+    }
+    CHECK(pool.misses() == 0);
+
+    // a third concurrent stream and inflate state sizes fall back to operator new
+    {
+        gzip::Compressor a(Z_DEFAULT_COMPRESSION, 2000000000, &pool);
+        gzip::Compressor b(Z_DEFAULT_COMPRESSION, 2000000000, &pool);
+        gzip::Compressor c(Z_DEFAULT_COMPRESSION, 2000000000, &pool);
+        std::string output;
+        a.compress(output, data.data(), data.size());
+        b.compress(output, data.data(), data.size());
+        c.compress(output, data.data(), data.size());
+        CHECK(output == expected);
+        gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::geometric(), &pool);
+        std::string decompressed;
+        decomp.decompress(decompressed, output.data(), output.size());
+        CHECK(decompressed == data);
+    }
+    CHECK(pool.misses() > 0);
+}
+
+TEST_CASE("allocator - slab pool shared between threads")
+{
+    std::string data = make_text(50000, 5);
+    std::string expected = gzip::compress(data.data(), data.size());
+    gzip::SlabPool pool(4);
+
+    std::vector<std::string> results(4);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < results.size(); ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int round = 0; round < 20; ++round)
+            {
+                gzip::Compressor comp(Z_DEFAULT_COMPRESSION, 2000000000, &pool);
+                comp.compress(results[t], data.data(), data.size());
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (auto const& result : results)
+    {
+        CHECK(result == expected);
+    }
+    CHECK(pool.misses() == 0);
+}
@@ -0,0 +1,188 @@
+#include <catch.hpp>
+#include <gzip/batch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include "test_data.hpp"
+
+static std::vector<std::string> make_tiles(std::size_t count)
+{
+    std::vector<std::string> tiles;
+    std::uint32_t seed = 9;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::size_t size = 100 + next_random(seed) % 20000;
+        tiles.push_back(make_text(size, next_random(seed)));
+    }
+    return tiles;
+}
+
+static std::vector<gzip::BufferView> make_views(std::vector<std::string> const& buffers)
+{
+    std::vector<gzip::BufferView> views;
+    for (auto const& buffer : buffers)
+    {
+        views.push_back(gzip::BufferView{buffer.data(), buffer.size()});
+    }
+    return views;
+}
+
+TEST_CASE("batch compress - every item matches gzip::compress")
+{
+    std::vector<std::string> tiles = make_tiles(300);
+    tiles.push_back(std::string());
+    std::vector<gzip::BufferView> views = make_views(tiles);
+
+    for (std::size_t threads : {1, 4})
+    {
+        gzip::BatchCompressor comp(Z_DEFAULT_COMPRESSION, threads);
+        gzip::BatchOutput output;
+        comp.compress(output, views);
+        REQUIRE(output.size() == tiles.size());
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+            gzip::BufferView item = output[i];
+            CHECK(std::string(item.data, item.size) == gzip::compress(tiles[i].data(), tiles[i].size()));
+            CHECK(gzip::decompress(item.data, item.size) == tiles[i]);
+            // items are packed back to back in the arena
+            CHECK(item.data == output.arena().data() + total);
+            total += item.size;
+        }
+        CHECK(output.arena().size() == total);
+    }
+}
+
+TEST_CASE("batch compress - reuse across calls")
+{
+    std::vector<std::string> tiles = make_tiles(50);
+    std::vector<gzip::BufferView> views = make_views(tiles);
+    gzip::BatchCompressor comp(Z_BEST_SPEED, 2);
+    gzip::BatchOutput output;
+
+    comp.compress(output, views);
+    std::string first = output.arena();
+    comp.compress(output, views.data(), 10);
+    CHECK(output.size() == 10);
+    CHECK(std::string(output[9].data, output[9].size) == gzip::compress(tiles[9].data(), tiles[9].size(), Z_BEST_SPEED));
+    comp.compress(output, views);
+    CHECK(output.arena() == first);
+
+    comp.compress(output, views.data(), 0);
+    CHECK(output.size() == 0);
+    CHECK(output.arena().empty());
+
+    CHECK(gzip::compress_batch(views, Z_BEST_SPEED, 3).arena() == first);
+}
+
+TEST_CASE("batch compress - limits")
+{
+    std::string tile = "hello hello hello hello";
+    std::vector<gzip::BufferView> views = {gzip::BufferView{tile.data(), tile.size()}};
+    gzip::BatchCompressor comp(Z_DEFAULT_COMPRESSION, 1, 10);
+    gzip::BatchOutput output;
+    CHECK_THROWS_WITH(comp.compress(output, views), Catch::Contains("size may use more memory than intended"));
+}
+
+TEST_CASE("batch decompress - round trip")
+{
+    std::vector<std::string> tiles = make_tiles(300);
+    tiles.push_back(std::string());
+    std::vector<gzip::BufferView> views = make_views(tiles);
+    gzip::BatchOutput compressed = gzip::compress_batch(views);
+    std::vector<gzip::BufferView> inputs;
+    for (std::size_t i = 0; i < compressed.size(); ++i)
+    {
+        inputs.push_back(compressed[i]);
+    }
+
+    for (std::size_t threads : {1, 4})
+    {
+        gzip::BatchDecompressor decomp(threads);
+        gzip::BatchOutput output;
+        decomp.decompress(output, inputs);
+        REQUIRE(output.size() == tiles.size());
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+            CHECK(std::string(output[i].data, output[i].size) == tiles[i]);
+            CHECK(output[i].data == output.arena().data() + total);
+            total += output[i].size;
+        }
+        // a second call reuses the arena and the inflate streams
+        decomp.decompress(output, inputs.data(), 7);
+        CHECK(output.size() == 7);
+        CHECK(std::string(output[6].data, output[6].size) == tiles[6]);
+    }
+}
+
+TEST_CASE("batch decompress - items the ISIZE trailer can not size")
+{
+    std::vector<std::string> tiles = make_tiles(20);
+    std::vector<std::string> compressed;
+    for (auto const& tile : tiles)
+    {
+        compressed.push_back(gzip::compress(tile.data(), tile.size()));
+    }
+    // two members in one item, and a zlib framed item
+    compressed[3] += gzip::compress(tiles[4].data(), tiles[4].size());
+    std::string zlib(compressBound(static_cast<uLong>(tiles[5].size())), '\0');
+    uLongf zlib_size = static_cast<uLongf>(zlib.size());
+    compress2(reinterpret_cast<Bytef*>(&zlib[0]), &zlib_size, reinterpret_cast<const Bytef*>(tiles[5].data()), static_cast<uLong>(tiles[5].size()), Z_DEFAULT_COMPRESSION);
+    zlib.resize(zlib_size);
+    compressed[5] = zlib;
+
+    gzip::BatchOutput output = gzip::decompress_batch(make_views(compressed), 3);
+    REQUIRE(output.size() == tiles.size());
+    for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+        std::string expected = i == 3 ? tiles[3] + tiles[4] : tiles[i];
+        CHECK(std::string(output[i].data, output[i].size) == expected);
+    }
+}
+
+TEST_CASE("batch decompress - errors")
+{
+    std::string data = "hello hello hello hello";
+    std::string compressed = gzip::compress(data.data(), data.size());
+    std::string corrupt = compressed;
+    corrupt[12] ^= 0x7F;
+
+    gzip::BatchDecompressor decomp(2);
+    gzip::BatchOutput output;
+    std::vector<gzip::BufferView> views = {gzip::BufferView{compressed.data(), compressed.size()}, gzip::BufferView{corrupt.data(), corrupt.size()}};
+    CHECK_THROWS(decomp.decompress(output, views));
+
+    gzip::BatchDecompressor limited(1, 10);
+    CHECK_THROWS_WITH(limited.decompress(output, views), Catch::Contains("size may use more memory than intended"));
+}
+
+TEST_CASE("batch decompress - forged ISIZE trailers reserve no memory")
+{
+    std::string data = "hello hello hello hello";
+    std::string forged = gzip::compress(data.data(), data.size());
+    // claims 900MB of output from a few bytes of deflate data
+    gzip::detail::put_le32(&forged[forged.size() - 4], 900000000u);
+    std::vector<std::string> items(4, forged);
+
+    gzip::BatchDecompressor decomp(2);
+    gzip::BatchOutput output;
+    CHECK_THROWS(decomp.decompress(output, make_views(items)));
+    CHECK(output.arena().capacity() < 1000000);
+
+    // plausible trailers that together exceed max_bytes: the later items are sized as they inflate
+    std::vector<std::string> tiles = make_tiles(6);
+    std::vector<std::string> compressed;
+    std::size_t total = 0;
+    for (auto const& tile : tiles)
+    {
+        compressed.push_back(gzip::compress(tile.data(), tile.size()));
+        total += tile.size();
+    }
+    gzip::BatchDecompressor limited(2, total / 2);
+    limited.decompress(output, make_views(compressed));
+    REQUIRE(output.size() == tiles.size());
+    for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+        CHECK(std::string(output[i].data, output[i].size) == tiles[i]);
+    }
+}
@@ -0,0 +1,92 @@
+#include <catch.hpp>
+#include <gzip/bgzf.hpp>
+#include <gzip/decompress.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("bgzf - output is standard multi-member gzip")
+{
+    std::string data = make_text(1000000, 5);
+    for (std::size_t threads : {1, 4})
+    {
+        gzip::BgzfCompressor comp(Z_DEFAULT_COMPRESSION, threads);
+        std::string compressed;
+        comp.compress(compressed, data.data(), data.size());
+        CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+
+        gzip::BgzfReader reader(compressed.data(), compressed.size(), threads);
+        // 16 data blocks plus the empty EOF block
+        REQUIRE(reader.blocks().size() == (data.size() + 65279) / 65280 + 1);
+        CHECK(reader.blocks().back().uncompressed_size == 0);
+        CHECK(reader.uncompressed_size() == data.size());
+        for (auto const& block : reader.blocks())
+        {
+            CHECK(block.compressed_size <= 65536);
+        }
+        std::string output;
+        reader.decompress(output);
+        CHECK(output == data);
+    }
+}
+
+TEST_CASE("bgzf - seek with virtual offsets")
+{
+    std::string data = make_text(500000, 5);
+    std::string compressed = gzip::compress_bgzf(data.data(), data.size());
+    gzip::BgzfReader reader(compressed.data(), compressed.size(), 2);
+
+    std::string output;
+    for (std::size_t offset : {std::size_t(0), std::size_t(65279), std::size_t(65280), std::size_t(200000), data.size() - 3})
+    {
+        std::uint64_t voffset = reader.virtual_offset(offset);
+        reader.read(output, voffset, 150000);
+        CHECK(output == data.substr(offset, 150000));
+    }
+
+    // the offset of the second block is the size of the first
+    CHECK(reader.virtual_offset(65280) == gzip::bgzf_virtual_offset(reader.blocks()[1].compressed_offset, 0));
+    CHECK(reader.virtual_offset(65281) == gzip::bgzf_virtual_offset(reader.blocks()[1].compressed_offset, 1));
+
+    reader.read(output, reader.virtual_offset(data.size()), 10);
+    CHECK(output.empty());
+
+    CHECK_THROWS_WITH(reader.read(output, gzip::bgzf_virtual_offset(1, 0), 10), Catch::Contains("invalid bgzf virtual offset"));
+}
+
+TEST_CASE("bgzf - edge cases")
+{
+    SECTION("empty input is just the EOF block")
+    {
+        std::string compressed = gzip::compress_bgzf("", 0);
+        CHECK(compressed.size() == 28);
+        gzip::BgzfReader reader(compressed.data(), compressed.size());
+        std::string output;
+        reader.decompress(output);
+        CHECK(output.empty());
+    }
+
+    SECTION("incompressible blocks still fit in 64Kb")
+    {
+        std::string data = make_noise(200000);
+        std::string compressed = gzip::compress_bgzf(data.data(), data.size(), Z_BEST_COMPRESSION);
+        gzip::BgzfReader reader(compressed.data(), compressed.size());
+        std::string output;
+        reader.decompress(output);
+        CHECK(output == data);
+    }
+
+    SECTION("plain gzip is rejected")
+    {
+        std::string compressed = gzip::compress("hello", 5);
+        CHECK_THROWS_WITH(gzip::BgzfReader(compressed.data(), compressed.size()), Catch::Contains("invalid bgzf block"));
+    }
+
+    SECTION("corrupt block")
+    {
+        std::string data = make_text(100000, 5);
+        std::string compressed = gzip::compress_bgzf(data.data(), data.size());
+        compressed[100] ^= 0x7F;
+        gzip::BgzfReader reader(compressed.data(), compressed.size());
+        std::string output;
+        CHECK_THROWS(reader.decompress(output));
+    }
+}
@@ -0,0 +1,69 @@
+#include <catch.hpp>
+#include <gzip/buffer.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("buffer - resize keeps contents and grows geometrically")
+{
+    gzip::Buffer buffer;
+    CHECK(buffer.empty());
+    CHECK(buffer.data() == nullptr);
+
+    buffer.resize(3);
+    buffer[0] = 'a';
+    buffer[1] = 'b';
+    buffer[2] = 'c';
+    buffer.resize(100);
+    CHECK(buffer.size() == 100);
+    CHECK(std::string(buffer.data(), 3) == "abc");
+    std::size_t capacity = buffer.capacity();
+    buffer.resize(101);
+    CHECK(buffer.capacity() >= 2 * capacity);
+
+    buffer.resize(2);
+    CHECK(buffer.str() == "ab");
+    CHECK(std::string(buffer.begin(), buffer.end()) == "ab");
+    buffer.clear();
+    CHECK(buffer.empty());
+    CHECK(buffer.capacity() >= 101);
+
+    gzip::Buffer moved(std::move(buffer));
+    CHECK(buffer.capacity() == 0);
+    CHECK(moved.capacity() >= 101);
+    gzip::Buffer sized(16);
+    CHECK(sized.size() == 16);
+    sized = std::move(moved);
+    CHECK(sized.size() == 0);
+}
+
+TEST_CASE("buffer - compress and decompress into a buffer")
+{
+    std::string data = make_text(300000, 17);
+    gzip::Compressor comp;
+    gzip::Buffer compressed;
+    comp.compress(compressed, data.data(), data.size());
+    CHECK(compressed.str() == gzip::compress(data.data(), data.size()));
+
+    // a small initial size makes decompress grow the buffer many times
+    gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::fixed(1024));
+    gzip::Buffer output;
+    decomp.decompress(output, compressed.data(), compressed.size());
+    CHECK(output.str() == data);
+
+    // reused buffers shrink to the output
+    std::string small = make_text(100, 17);
+    comp.compress(compressed, small.data(), small.size());
+    decomp.decompress(output, compressed.data(), compressed.size());
+    CHECK(output.str() == small);
+}
+
+TEST_CASE("buffer - strings still come out exact")
+{
+    std::string data = make_text(200000, 17);
+    std::string compressed;
+    gzip::Compressor().compress(compressed, data.data(), data.size());
+    std::string output = "previous contents";
+    gzip::Decompressor(1000000000, false, gzip::GrowthPolicy::fixed(4096)).decompress(output, compressed.data(), compressed.size());
+    CHECK(output == data);
+}
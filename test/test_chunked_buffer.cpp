@@ -0,0 +1,122 @@
+#include <catch.hpp>
+#include <gzip/chunked_buffer.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/dictionary.hpp>
+#include "test_data.hpp"
+
+#include <cstdio>
+#include <unistd.h>
+
+TEST_CASE("chunked buffer - grow and trim")
+{
+    gzip::ChunkedBuffer buffer(16);
+    CHECK(buffer.empty());
+    char* first = buffer.grow();
+    std::memcpy(first, "0123456789abcdef", 16);
+    char* second = buffer.grow();
+    std::memcpy(second, "ghij", 4);
+    buffer.trim(12);
+    CHECK(buffer.size() == 20);
+    REQUIRE(buffer.segments().size() == 2);
+    CHECK(buffer.segments()[1].iov_len == 4);
+    CHECK(buffer.str() == "0123456789abcdefghij");
+
+    // trimming across a chunk boundary releases the emptied chunk
+    buffer.trim(10);
+    CHECK(buffer.segments().size() == 1);
+    CHECK(buffer.str() == "0123456789");
+
+    gzip::ChunkedBuffer moved(std::move(buffer));
+    CHECK(buffer.empty());
+    CHECK(moved.size() == 10);
+    moved.clear();
+    CHECK(moved.segments().empty());
+
+    // chunks of 0 bytes could never hold any output
+    CHECK_THROWS_WITH(gzip::ChunkedBuffer(0), "chunk size must not be 0");
+    CHECK_THROWS_WITH(gzip::ChunkPool(0), "chunk size must not be 0");
+}
+
+TEST_CASE("chunked buffer - decompress fills chunks without moving them")
+{
+    std::string data = make_text(1000000, 29);
+    std::string compressed = gzip::compress(data.data(), data.size());
+
+    gzip::Decompressor decomp;
+    gzip::ChunkedBuffer output(64 * 1024);
+    decomp.decompress(output, compressed.data(), compressed.size());
+    CHECK(output.size() == data.size());
+    CHECK(output.segments().size() == (data.size() + 64 * 1024 - 1) / (64 * 1024));
+    CHECK(output.str() == data);
+
+    // concatenated members and an exact multiple of the chunk size
+    std::string exact = make_text(128 * 1024, 29);
+    std::string members = gzip::compress(exact.data(), exact.size()) + gzip::compress(exact.data(), exact.size());
+    decomp.decompress(output, members.data(), members.size());
+    CHECK(output.segments().size() == 4);
+    CHECK(output.str() == exact + exact);
+
+    std::string empty = gzip::compress("", 0);
+    decomp.decompress(output, empty.data(), empty.size());
+    CHECK(output.empty());
+    CHECK(output.segments().empty());
+}
+
+TEST_CASE("chunked buffer - pool reuses chunks")
+{
+    std::string data = make_text(300000, 29);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    gzip::ChunkPool pool(32 * 1024);
+    gzip::Decompressor decomp;
+    {
+        gzip::ChunkedBuffer output(pool);
+        decomp.decompress(output, compressed.data(), compressed.size());
+        CHECK(output.str() == data);
+        CHECK(pool.free_chunks() <= 1);
+        // a second call hands the chunks of the first back to the pool before taking them again
+        decomp.decompress(output, compressed.data(), compressed.size());
+        CHECK(output.str() == data);
+    }
+    CHECK(pool.free_chunks() == (data.size() + 32 * 1024 - 1) / (32 * 1024));
+}
+
+TEST_CASE("chunked buffer - limits, dictionaries and errors")
+{
+    std::string data = make_text(100000, 29);
+    std::string compressed = gzip::compress(data.data(), data.size());
+
+    gzip::Decompressor exact(data.size());
+    gzip::ChunkedBuffer output(4096);
+    exact.decompress(output, compressed.data(), compressed.size());
+    CHECK(output.str() == data);
+    gzip::Decompressor small(data.size() - 1);
+    CHECK_THROWS_WITH(small.decompress(output, compressed.data(), compressed.size()), "size of output string will use more memory then intended when decompressing");
+    CHECK(output.empty());
+
+    gzip::Dictionary dictionary(make_text(2000, 29));
+    std::string dict_compressed;
+    gzip::Compressor(dictionary).compress(dict_compressed, data.data(), data.size());
+    gzip::Decompressor dict_decomp(dictionary);
+    dict_decomp.decompress(output, dict_compressed.data(), dict_compressed.size());
+    CHECK(output.str() == data);
+    dict_compressed[dict_compressed.size() - 1] = static_cast<char>(dict_compressed[dict_compressed.size() - 1] ^ 1);
+    CHECK_THROWS_WITH(dict_decomp.decompress(output, dict_compressed.data(), dict_compressed.size()), "incorrect data check");
+}
+
+TEST_CASE("chunked buffer - segments go straight to writev")
+{
+    std::string data = make_text(200000, 29);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    gzip::ChunkedBuffer output(16 * 1024);
+    gzip::Decompressor().decompress(output, compressed.data(), compressed.size());
+
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    ssize_t written = writev(fileno(file), output.segments().data(), static_cast<int>(output.segments().size()));
+    CHECK(written == static_cast<ssize_t>(data.size()));
+    std::string read_back(data.size(), '\0');
+    CHECK(pread(fileno(file), &read_back[0], read_back.size(), 0) == static_cast<ssize_t>(data.size()));
+    CHECK(read_back == data);
+    std::fclose(file);
+}
@@ -0,0 +1,40 @@
+#ifndef GZIP_TEST_DATA_HPP_INCLUDED
+#define GZIP_TEST_DATA_HPP_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+// A linear congruential generator: the same seed always gives the same sequence
+inline std::uint32_t next_random(std::uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+}
+
+// Lines of text with a pseudo random part, repetitive enough that deflate emits many blocks
+// with back references, varied enough that blocks differ and references cross block edges
+inline std::string make_text(std::size_t size, std::uint32_t seed = 1)
+{
+    std::string data;
+    data.reserve(size);
+    while (data.size() < size)
+    {
+        std::uint32_t value = next_random(seed);
+        data += "record " + std::to_string(value % 1000) + " value " + std::to_string(value >> 20) + "\n";
+    }
+    data.resize(size);
+    return data;
+}
+
+// Pseudo random bytes that deflate can not shrink
+inline std::string make_noise(std::size_t size, std::uint32_t seed = 1)
+{
+    std::string data(size, '\0');
+    for (auto& c : data)
+    {
+        c = static_cast<char>(next_random(seed) >> 24);
+    }
+    return data;
+}
+
+#endif
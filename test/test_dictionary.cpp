@@ -0,0 +1,195 @@
+#include <catch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/dictionary.hpp>
+#include <gzip/dictionary_trainer.hpp>
+#include "test_data.hpp"
+
+#include <type_traits>
+
+static std::string make_dictionary_payload(std::uint32_t seed)
+{
+    // small JSON messages sharing their keys and most of their values
+    std::string data;
+    for (int i = 0; i < 12; ++i)
+    {
+        std::uint32_t value = next_random(seed);
+        data += "{\"layer\":\"roads\",\"class\":\"highway\",\"name\":\"Route " + std::to_string(value % 90) + "\",\"oneway\":" + (value & 1 ? "true" : "false") + "}\n";
+    }
+    return data;
+}
+
+TEST_CASE("dictionary - round trip in zlib and raw framing")
+{
+    std::string sample = make_dictionary_payload(1) + make_dictionary_payload(2);
+    gzip::Dictionary dictionary(sample);
+    std::string data = make_dictionary_payload(99);
+
+    for (auto framing : {gzip::DictionaryFraming::zlib, gzip::DictionaryFraming::raw})
+    {
+        gzip::Compressor comp(dictionary, framing);
+        gzip::Decompressor decomp(dictionary, framing);
+        std::string compressed;
+        std::string output;
+        for (int call = 0; call < 3; ++call)
+        {
+            comp.compress(compressed, data.data(), data.size());
+            decomp.decompress(output, compressed.data(), compressed.size());
+            CHECK(output == data);
+        }
+
+        // the dictionary pays off on a small payload
+        std::string plain = gzip::compress(data.data(), data.size());
+        CHECK(compressed.size() * 2 < plain.size());
+
+        comp.compress(compressed, "", 0);
+        decomp.decompress(output, compressed.data(), compressed.size());
+        CHECK(output.empty());
+    }
+}
+
+TEST_CASE("dictionary - zlib framing records the dictionary id")
+{
+    std::string sample = make_dictionary_payload(3);
+    gzip::Dictionary dictionary(sample);
+    CHECK(dictionary.id() == adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(sample.data()), static_cast<unsigned int>(sample.size())));
+
+    std::string data = make_dictionary_payload(4);
+    std::string compressed;
+    gzip::Compressor(dictionary).compress(compressed, data.data(), data.size());
+    std::uint32_t id = 0;
+    CHECK(gzip::dictionary_id(compressed.data(), compressed.size(), id));
+    CHECK(id == dictionary.id());
+
+    // data without a dictionary has no id
+    std::string plain = gzip::compress(data.data(), data.size());
+    CHECK_FALSE(gzip::dictionary_id(plain.data(), plain.size(), id));
+
+    // only the last 32Kb of a long sample are kept
+    std::string long_sample(100000, 'x');
+    long_sample += sample;
+    gzip::Dictionary trimmed(long_sample);
+    CHECK(trimmed.size() == 32768);
+    CHECK(std::string(trimmed.data() + trimmed.size() - sample.size(), sample.size()) == sample);
+}
+
+TEST_CASE("dictionary - wrong or missing dictionary is an error")
+{
+    std::string data = make_dictionary_payload(5);
+    std::string sample = make_dictionary_payload(6);
+    std::string other_sample = make_dictionary_payload(7);
+    gzip::Dictionary dictionary(sample);
+    gzip::Dictionary other(other_sample);
+
+    std::string compressed;
+    gzip::Compressor(dictionary).compress(compressed, data.data(), data.size());
+    std::string output;
+    gzip::Decompressor wrong(other);
+    CHECK_THROWS_WITH(wrong.decompress(output, compressed.data(), compressed.size()), "compressed data needs a different preset dictionary");
+    gzip::Decompressor none;
+    CHECK_THROWS_WITH(none.decompress(output, compressed.data(), compressed.size()), "compressed data needs a different preset dictionary");
+
+    // the plain decompressor still handles ordinary data after the error
+    std::string plain = gzip::compress(data.data(), data.size());
+    none.decompress(output, plain.data(), plain.size());
+    CHECK(output == data);
+}
+
+TEST_CASE("dictionary - zlib trailer is checked")
+{
+    std::string sample = make_dictionary_payload(8);
+    gzip::Dictionary dictionary(sample);
+    std::string data = make_dictionary_payload(9);
+    std::string compressed;
+    gzip::Compressor(dictionary).compress(compressed, data.data(), data.size());
+
+    gzip::Decompressor decomp(dictionary);
+    std::string output;
+    std::vector<gzip::Member> members;
+    decomp.decompress(output, compressed.data(), compressed.size(), members);
+    CHECK(output == data);
+    REQUIRE(members.size() == 1);
+    CHECK(members[0].compressed_size == compressed.size());
+    CHECK(members[0].uncompressed_size == data.size());
+
+    std::string corrupt = compressed;
+    corrupt[corrupt.size() - 1] = static_cast<char>(corrupt[corrupt.size() - 1] ^ 1);
+    CHECK_THROWS_WITH(decomp.decompress(output, corrupt.data(), corrupt.size()), "incorrect data check");
+    std::string truncated = compressed.substr(0, compressed.size() - 2);
+    CHECK_THROWS_WITH(decomp.decompress(output, truncated.data(), truncated.size()), "incorrect data check");
+
+    // zlib data without a dictionary still decodes
+    gzip::Dictionary empty("", 0);
+    gzip::Compressor plain_comp(empty);
+    std::string plain;
+    plain_comp.compress(plain, data.data(), data.size());
+    decomp.decompress(output, plain.data(), plain.size());
+    CHECK(output == data);
+}
+
+TEST_CASE("dictionary - temporaries are rejected")
+{
+    // the dictionary is held by pointer and must outlive the compressor
+    CHECK_FALSE(std::is_constructible<gzip::Compressor, gzip::Dictionary&&>::value);
+    CHECK_FALSE(std::is_constructible<gzip::Compressor, gzip::Dictionary&&, gzip::DictionaryFraming>::value);
+    CHECK_FALSE(std::is_constructible<gzip::Decompressor, gzip::Dictionary&&>::value);
+    CHECK_FALSE(std::is_constructible<gzip::Decompressor, gzip::Dictionary&&, gzip::DictionaryFraming>::value);
+    CHECK(std::is_constructible<gzip::Compressor, gzip::Dictionary&>::value);
+    CHECK(std::is_constructible<gzip::Decompressor, gzip::Dictionary const&>::value);
+}
+
+TEST_CASE("dictionary trainer - trained dictionary compresses held out payloads")
+{
+    gzip::DictionaryTrainer trainer;
+    for (std::uint32_t seed = 100; seed < 400; ++seed)
+    {
+        trainer.add_sample(make_dictionary_payload(seed));
+    }
+    CHECK(trainer.samples() == 300);
+    gzip::Dictionary dictionary = trainer.train();
+    CHECK(dictionary.size() > 0);
+    CHECK(dictionary.size() <= 32768);
+    // the most shared strings end up in the dictionary
+    std::string bytes(dictionary.data(), dictionary.size());
+    CHECK(bytes.find("\"class\":\"highway\"") != std::string::npos);
+
+    gzip::Compressor comp(dictionary);
+    gzip::Decompressor decomp(dictionary);
+    std::size_t with = 0;
+    std::size_t without = 0;
+    for (std::uint32_t seed = 1000; seed < 1050; ++seed)
+    {
+        std::string data = make_dictionary_payload(seed);
+        std::string compressed;
+        comp.compress(compressed, data.data(), data.size());
+        std::string output;
+        decomp.decompress(output, compressed.data(), compressed.size());
+        CHECK(output == data);
+        with += compressed.size();
+        without += gzip::compress(data.data(), data.size()).size();
+    }
+    CHECK(with * 2 < without);
+}
+
+TEST_CASE("dictionary trainer - capacity and degenerate corpora")
+{
+    std::vector<std::string> samples;
+    for (std::uint32_t seed = 1; seed < 200; ++seed)
+    {
+        samples.push_back(make_dictionary_payload(seed));
+    }
+    gzip::Dictionary small = gzip::train_dictionary(samples, 1024);
+    CHECK(small.size() > 0);
+    CHECK(small.size() <= 1024);
+
+    // nothing shared between samples, nothing to learn
+    CHECK(gzip::DictionaryTrainer().train().size() == 0);
+    gzip::DictionaryTrainer single;
+    single.add_sample(samples[0]);
+    CHECK(single.train().size() == 0);
+    gzip::DictionaryTrainer tiny;
+    tiny.add_sample("ab", 2);
+    tiny.add_sample("ab", 2);
+    tiny.add_sample("", 0);
+    CHECK(tiny.train().size() == 0);
+}
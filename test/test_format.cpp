@@ -0,0 +1,132 @@
+#include <catch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/format.hpp>
+#include <gzip/utils.hpp>
+#include "test_data.hpp"
+
+template <typename Format>
+static std::string format_round_trip(std::string const& data)
+{
+    gzip::BasicCompressor<Format> comp;
+    std::string compressed;
+    comp.compress(compressed, data.data(), data.size());
+    gzip::BasicDecompressor<Format> decomp;
+    std::string output;
+    decomp.decompress(output, compressed.data(), compressed.size());
+    CHECK(output == data);
+    return compressed;
+}
+
+TEST_CASE("format - each framing round trips")
+{
+    std::string data = make_text(100000, 11);
+
+    std::string gz = format_round_trip<gzip::GzipFormat<>>(data);
+    CHECK(gzip::is_compressed(gz.data(), gz.size()));
+    CHECK(gz == gzip::compress(data.data(), data.size()));
+
+    std::string zlib = format_round_trip<gzip::ZlibFormat<>>(data);
+    CHECK(static_cast<unsigned char>(zlib[0]) == 0x78);
+    // a zlib header and adler32 trailer take 6 bytes, a gzip header and trailer 18
+    CHECK(zlib.size() + 12 == gz.size());
+
+    std::string raw = format_round_trip<gzip::RawFormat<>>(data);
+    CHECK(raw.size() + 18 == gz.size());
+    CHECK(raw == gz.substr(10, raw.size()));
+
+    // smaller windows and memory levels still round trip
+    format_round_trip<gzip::GzipFormat<9, 1>>(data);
+    format_round_trip<gzip::ZlibFormat<12, 9>>(data);
+    format_round_trip<gzip::RawFormat<10, 4>>(data);
+    format_round_trip<gzip::AutoFormat<9, 2>>(data);
+
+    std::string empty = format_round_trip<gzip::RawFormat<>>("");
+    CHECK(empty.size() < 4);
+}
+
+TEST_CASE("format - default decompressor detects gzip and zlib")
+{
+    std::string data = make_text(5000, 11);
+    gzip::Decompressor decomp;
+    std::string output;
+
+    std::string zlib;
+    gzip::BasicCompressor<gzip::ZlibFormat<>>().compress(zlib, data.data(), data.size());
+    decomp.decompress(output, zlib.data(), zlib.size());
+    CHECK(output == data);
+
+    std::string gz;
+    gzip::Compressor().compress(gz, data.data(), data.size());
+    decomp.decompress(output, gz.data(), gz.size());
+    CHECK(output == data);
+
+    // a fixed framing refuses the other one
+    gzip::BasicDecompressor<gzip::GzipFormat<>> gzip_only;
+    CHECK_THROWS_WITH(gzip_only.decompress(output, zlib.data(), zlib.size()), "incorrect header check");
+    gzip::BasicDecompressor<gzip::ZlibFormat<>> zlib_only;
+    CHECK_THROWS_WITH(zlib_only.decompress(output, gz.data(), gz.size()), "incorrect header check");
+    zlib_only.decompress(output, zlib.data(), zlib.size());
+    CHECK(output == data);
+}
+
+TEST_CASE("format - only gzip reads concatenated members")
+{
+    std::string a = make_text(3000, 11);
+    std::string b = make_text(2000, 11);
+    std::string output;
+
+    std::string gz = gzip::compress(a.data(), a.size()) + gzip::compress(b.data(), b.size());
+    gzip::BasicDecompressor<gzip::GzipFormat<>> gzip_decomp;
+    gzip_decomp.decompress(output, gz.data(), gz.size());
+    CHECK(output == a + b);
+
+    // raw deflate has no trailer, decoding stops at the end of the first stream
+    std::string raw;
+    gzip::BasicCompressor<gzip::RawFormat<>>().compress(raw, a.data(), a.size());
+    std::string twice = raw + raw;
+    gzip::BasicDecompressor<gzip::RawFormat<>> raw_decomp;
+    raw_decomp.decompress(output, twice.data(), twice.size());
+    CHECK(output == a);
+}
+
+TEST_CASE("format - a gzip member after a zlib stream is not decoded")
+{
+    std::string a = make_text(3000, 11);
+    std::string b = make_text(2000, 12);
+    std::string zlib;
+    gzip::BasicCompressor<gzip::ZlibFormat<>>().compress(zlib, a.data(), a.size());
+    std::string mixed = zlib + gzip::compress(b.data(), b.size());
+
+    gzip::Decompressor decomp;
+    std::string output;
+    decomp.decompress(output, mixed.data(), mixed.size());
+    CHECK(output == a);
+
+    gzip::ChunkedBuffer chunked(1024);
+    decomp.decompress(chunked, mixed.data(), mixed.size());
+    CHECK(chunked.str() == a);
+
+    std::string into(a.size() + b.size(), '\0');
+    gzip::WriteResult result = decomp.decompress_into(&into[0], into.size(), mixed.data(), mixed.size());
+    CHECK(into.substr(0, result.size) == a);
+}
+
+TEST_CASE("format - raw framing does not check the data")
+{
+    std::string data = make_text(5000, 11);
+    std::string zlib;
+    gzip::BasicCompressor<gzip::ZlibFormat<>>().compress(zlib, data.data(), data.size());
+    std::string output;
+
+    // a flipped trailer byte fails the adler32 check of zlib framing
+    std::string corrupt = zlib;
+    corrupt[corrupt.size() - 1] = static_cast<char>(corrupt[corrupt.size() - 1] ^ 1);
+    gzip::BasicDecompressor<gzip::ZlibFormat<>> zlib_decomp;
+    CHECK_THROWS_WITH(zlib_decomp.decompress(output, corrupt.data(), corrupt.size()), "incorrect data check");
+
+    // the deflate data inside decodes as raw without looking at the trailer
+    gzip::BasicDecompressor<gzip::RawFormat<>> raw_decomp;
+    raw_decomp.decompress(output, corrupt.data() + 2, corrupt.size() - 2);
+    CHECK(output == data);
+}
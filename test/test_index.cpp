@@ -0,0 +1,113 @@
+#include <catch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/index.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("index - random access matches full decompression")
+{
+    std::string data = make_text(2000000, 11);
+    std::string compressed = gzip::compress(data.data(), data.size());
+
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 100000);
+    CHECK(index.uncompressed_size() == data.size());
+    CHECK(index.compressed_size() == compressed.size());
+    REQUIRE(index.checkpoints().size() > 5);
+    CHECK(index.checkpoints().front().uncompressed_offset == 0);
+
+    gzip::IndexedDecompressor reader;
+    std::string output;
+    for (std::size_t offset : {std::size_t(0), std::size_t(1), std::size_t(99999), std::size_t(100000), std::size_t(777777), data.size() - 10})
+    {
+        reader.decompress(output, compressed.data(), compressed.size(), index, offset, 5000);
+        CHECK(output == data.substr(offset, 5000));
+    }
+
+    // a range spanning several checkpoints
+    reader.decompress(output, compressed.data(), compressed.size(), index, 150000, 600000);
+    CHECK(output == data.substr(150000, 600000));
+
+    // reading past the end returns nothing
+    reader.decompress(output, compressed.data(), compressed.size(), index, data.size(), 10);
+    CHECK(output.empty());
+}
+
+TEST_CASE("index - serialize round trip")
+{
+    std::string data = make_text(500000, 11);
+    std::string compressed = gzip::compress(data.data(), data.size(), Z_BEST_SPEED);
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 65536);
+
+    std::string blob = index.serialize();
+    gzip::Index loaded = gzip::Index::deserialize(blob.data(), blob.size());
+    CHECK(loaded.span() == index.span());
+    CHECK(loaded.uncompressed_size() == index.uncompressed_size());
+    REQUIRE(loaded.checkpoints().size() == index.checkpoints().size());
+    for (std::size_t i = 0; i < index.checkpoints().size(); ++i)
+    {
+        CHECK(loaded.checkpoints()[i].compressed_offset == index.checkpoints()[i].compressed_offset);
+        CHECK(loaded.checkpoints()[i].bits == index.checkpoints()[i].bits);
+        CHECK(loaded.checkpoints()[i].window == index.checkpoints()[i].window);
+    }
+
+    gzip::IndexedDecompressor reader;
+    std::string output;
+    reader.decompress(output, compressed.data(), compressed.size(), loaded, 300001, 1234);
+    CHECK(output == data.substr(300001, 1234));
+
+    SECTION("corrupt blobs are rejected")
+    {
+        CHECK_THROWS_WITH(gzip::Index::deserialize(blob.data(), 20), Catch::Contains("invalid gzip index"));
+        CHECK_THROWS_WITH(gzip::Index::deserialize(blob.data(), blob.size() - 1), Catch::Contains("invalid gzip index"));
+        std::string bad = blob;
+        bad[0] = 'X';
+        CHECK_THROWS_WITH(gzip::Index::deserialize(bad.data(), bad.size()), Catch::Contains("invalid gzip index"));
+    }
+}
+
+TEST_CASE("index - concatenated members")
+{
+    std::string first = make_text(300000, 11);
+    std::string second = make_text(200000, 11) + "tail";
+    std::string compressed = gzip::compress(first.data(), first.size()) + gzip::compress(second.data(), second.size());
+    std::string data = first + second;
+
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 50000);
+    CHECK(index.uncompressed_size() == data.size());
+
+    gzip::IndexedDecompressor reader;
+    std::string output;
+    // starts in the first member and runs into the second
+    reader.decompress(output, compressed.data(), compressed.size(), index, 290000, 20000);
+    CHECK(output == data.substr(290000, 20000));
+    reader.decompress(output, compressed.data(), compressed.size(), index, 420000, 100000);
+    CHECK(output == data.substr(420000, 100000));
+}
+
+TEST_CASE("index - errors")
+{
+    std::string data = make_text(100000, 11);
+    std::string compressed = gzip::compress(data.data(), data.size());
+
+    SECTION("truncated input")
+    {
+        CHECK_THROWS_WITH(gzip::Index::build(compressed.data(), compressed.size() / 2), Catch::Contains("compressed stream is truncated"));
+    }
+
+    SECTION("index built for other data")
+    {
+        gzip::Index index = gzip::Index::build(compressed.data(), compressed.size());
+        std::string other = gzip::compress("abc", 3);
+        gzip::IndexedDecompressor reader;
+        std::string output;
+        CHECK_THROWS_WITH(reader.decompress(output, other.data(), other.size(), index, 0, 1), Catch::Contains("does not match"));
+    }
+
+    SECTION("range above max_bytes")
+    {
+        gzip::Index index = gzip::Index::build(compressed.data(), compressed.size());
+        gzip::IndexedDecompressor reader(1000);
+        std::string output;
+        CHECK_THROWS_WITH(reader.decompress(output, compressed.data(), compressed.size(), index, 0, 1001), Catch::Contains("more memory then intended"));
+    }
+}
@@ -0,0 +1,153 @@
+#include <catch.hpp>
+#include <gzip/allocator.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/dictionary.hpp>
+#include "test_data.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Counts the zlib allocations made through it
+class CountingAllocator : public gzip::Allocator
+{
+  public:
+    std::size_t allocations = 0;
+
+    void* allocate(std::size_t size) override
+    {
+        ++allocations;
+        return std::malloc(size);
+    }
+
+    void deallocate(void* pointer) override
+    {
+        std::free(pointer);
+    }
+};
+
+} // namespace
+
+template <typename Format>
+static void check_exact_fit(std::string const& data)
+{
+    gzip::BasicCompressor<Format> comp;
+    std::string expected;
+    comp.compress(expected, data.data(), data.size());
+
+    std::vector<char> output(expected.size() + 64);
+    gzip::WriteResult result = comp.compress_into(output.data(), output.size(), data.data(), data.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(std::string(output.data(), result.size) == expected);
+
+    result = comp.compress_into(output.data(), expected.size(), data.data(), data.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(result.size == expected.size());
+    CHECK(std::string(output.data(), result.size) == expected);
+
+    result = comp.compress_into(output.data(), expected.size() - 1, data.data(), data.size());
+    CHECK(result.insufficient_space);
+
+    gzip::BasicDecompressor<Format> decomp;
+    std::vector<char> plain(data.size() + 1);
+    result = decomp.decompress_into(plain.data(), data.size(), expected.data(), expected.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(std::string(plain.data(), result.size) == data);
+    if (!data.empty())
+    {
+        result = decomp.decompress_into(plain.data(), data.size() - 1, expected.data(), expected.size());
+        CHECK(result.insufficient_space);
+    }
+    result = decomp.decompress_into(plain.data(), plain.size(), expected.data(), expected.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(result.size == data.size());
+}
+
+TEST_CASE("into - exact fit succeeds and one byte less does not")
+{
+    for (std::size_t size : {std::size_t(0), std::size_t(1), std::size_t(1000), std::size_t(200000)})
+    {
+        std::string data = make_text(size, 23);
+        check_exact_fit<gzip::GzipFormat<>>(data);
+        check_exact_fit<gzip::ZlibFormat<>>(data);
+        check_exact_fit<gzip::RawFormat<>>(data);
+    }
+}
+
+TEST_CASE("into - empty input needs no output memory")
+{
+    std::string empty = gzip::compress("", 0);
+    gzip::Decompressor decomp;
+    gzip::WriteResult result = decomp.decompress_into(nullptr, 0, empty.data(), empty.size());
+    CHECK(result.size == 0);
+    CHECK_FALSE(result.insufficient_space);
+
+    std::string data = "not empty";
+    std::string compressed = gzip::compress(data.data(), data.size());
+    CHECK(decomp.decompress_into(nullptr, 0, compressed.data(), compressed.size()).insufficient_space);
+}
+
+TEST_CASE("into - compressor recovers after running out of space")
+{
+    std::string data = make_text(50000, 23);
+    gzip::Compressor comp;
+    char tiny[16];
+    CHECK(comp.compress_into(tiny, sizeof(tiny), data.data(), data.size()).insufficient_space);
+    CHECK(comp.compress_into(tiny, 0, data.data(), data.size()).insufficient_space);
+
+    std::vector<char> output(data.size());
+    gzip::WriteResult result = comp.compress_into(output.data(), output.size(), data.data(), data.size());
+    REQUIRE_FALSE(result.insufficient_space);
+    CHECK(gzip::decompress(output.data(), result.size) == data);
+}
+
+TEST_CASE("into - decompress handles members, dictionaries and errors")
+{
+    std::string a = make_text(3000, 23);
+    std::string b = make_text(7000, 23);
+    std::string members = gzip::compress(a.data(), a.size()) + gzip::compress(b.data(), b.size());
+    gzip::Decompressor decomp;
+    std::vector<char> output(a.size() + b.size());
+    gzip::WriteResult result = decomp.decompress_into(output.data(), output.size(), members.data(), members.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(std::string(output.data(), result.size) == a + b);
+    CHECK(decomp.decompress_into(output.data(), output.size() - 1, members.data(), members.size()).insufficient_space);
+
+    gzip::Dictionary dictionary(b);
+    std::string compressed;
+    gzip::Compressor(dictionary).compress(compressed, a.data(), a.size());
+    gzip::Decompressor dict_decomp(dictionary);
+    result = dict_decomp.decompress_into(output.data(), output.size(), compressed.data(), compressed.size());
+    CHECK_FALSE(result.insufficient_space);
+    CHECK(std::string(output.data(), result.size) == a);
+    compressed[compressed.size() - 1] = static_cast<char>(compressed[compressed.size() - 1] ^ 1);
+    CHECK_THROWS_WITH(dict_decomp.decompress_into(output.data(), output.size(), compressed.data(), compressed.size()), "incorrect data check");
+
+    // a gzip header followed by a block of the reserved type 3
+    std::string garbage("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03\x07", 11);
+    CHECK_THROWS_WITH(decomp.decompress_into(output.data(), output.size(), garbage.data(), garbage.size()), "invalid block type");
+}
+
+TEST_CASE("into - no allocations once the stream exists")
+{
+    std::string data = make_text(100000, 23);
+    CountingAllocator allocator;
+    gzip::Compressor comp(Z_DEFAULT_COMPRESSION, 2000000000, &allocator);
+    gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::geometric(), &allocator);
+    std::vector<char> compressed(data.size());
+    std::vector<char> output(data.size());
+
+    gzip::WriteResult packed = comp.compress_into(compressed.data(), compressed.size(), data.data(), data.size());
+    decomp.decompress_into(output.data(), output.size(), compressed.data(), packed.size);
+    std::size_t warm = allocator.allocations;
+    CHECK(warm > 0);
+    for (int call = 0; call < 3; ++call)
+    {
+        packed = comp.compress_into(compressed.data(), compressed.size(), data.data(), data.size());
+        gzip::WriteResult result = decomp.decompress_into(output.data(), output.size(), compressed.data(), packed.size);
+        CHECK(std::string(output.data(), result.size) == data);
+    }
+    CHECK(allocator.allocations == warm);
+}
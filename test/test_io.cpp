@@ -4,6 +4,7 @@
 #include <gzip/compress.hpp>
 #include <gzip/decompress.hpp>
 #include <gzip/utils.hpp>
+#include "test_data.hpp"
 
 TEST_CASE("successful compress")
 {
@@ -41,6 +42,56 @@ TEST_CASE("fail compress - pointer, debug throws int overflow")
 }
 #endif
 
+TEST_CASE("compressor reuses its stream across calls")
+{
+    std::string data = "hello hello hello hello";
+    std::string other = "a completely different payload of some length";
+    gzip::Compressor comp;
+
+    std::string first;
+    comp.compress(first, data.data(), data.size());
+    std::string second;
+    comp.compress(second, other.data(), other.size());
+    std::string third;
+    comp.compress(third, data.data(), data.size());
+
+    CHECK(first == gzip::compress(data.data(), data.size()));
+    CHECK(second == gzip::compress(other.data(), other.size()));
+    CHECK(first == third);
+
+    SECTION("moved compressor keeps working")
+    {
+        gzip::Compressor moved(std::move(comp));
+        std::string output;
+        moved.compress(output, data.data(), data.size());
+        CHECK(output == first);
+
+        gzip::Compressor assigned;
+        assigned = std::move(moved);
+        assigned.compress(output, other.data(), other.size());
+        CHECK(output == second);
+    }
+}
+
+TEST_CASE("round trip compression - incompressible input")
+{
+    // random bytes deflate cannot shrink, so the output is larger than the input
+    std::string data = make_noise(100000);
+
+    gzip::Compressor comp;
+    std::string compressed_data;
+    comp.compress(compressed_data, data.data(), data.size());
+    CHECK(compressed_data.size() > data.size());
+    CHECK(gzip::decompress(compressed_data.data(), compressed_data.size()) == data);
+
+    SECTION("empty input")
+    {
+        comp.compress(compressed_data, data.data(), 0);
+        CHECK(gzip::is_compressed(compressed_data.data(), compressed_data.size()));
+        CHECK(gzip::decompress(compressed_data.data(), compressed_data.size()).empty());
+    }
+}
+
 TEST_CASE("successful decompress - pointer")
 {
     std::string data = "hello hello hello hello";
@@ -68,6 +119,185 @@ TEST_CASE("fail decompress - pointer, debug throws int overflow")
 }
 #endif
 
+TEST_CASE("decompressor reuses its stream across calls")
+{
+    std::string data = "hello hello hello hello";
+    std::string other = "a completely different payload of some length";
+    std::string compressed_data = gzip::compress(data.data(), data.size());
+    std::string compressed_other = gzip::compress(other.data(), other.size());
+    std::string garbage("this is a string that should be compressed data");
+    gzip::Decompressor decomp;
+
+    std::string output;
+    decomp.decompress(output, compressed_data.data(), compressed_data.size());
+    CHECK(output == data);
+    decomp.decompress(output, compressed_other.data(), compressed_other.size());
+    CHECK(output == other);
+
+    // a failed call must not poison the next one
+    CHECK_THROWS(decomp.decompress(output, garbage.data(), garbage.size()));
+    decomp.decompress(output, compressed_data.data(), compressed_data.size());
+    CHECK(output == data);
+
+    SECTION("moved decompressor keeps working")
+    {
+        gzip::Decompressor moved(std::move(decomp));
+        moved.decompress(output, compressed_other.data(), compressed_other.size());
+        CHECK(output == other);
+    }
+}
+
+TEST_CASE("decompress using the gzip ISIZE trailer")
+{
+    std::string data;
+    for (int i = 0; i < 2000; ++i)
+    {
+        data += "hello hello hello hello ";
+    }
+    std::string compressed_data = gzip::compress(data.data(), data.size());
+
+    std::uint32_t isize = 0;
+    REQUIRE(gzip::read_isize(compressed_data.data(), compressed_data.size(), isize));
+    CHECK(isize == data.size());
+
+    gzip::Decompressor decomp(1000000000, true);
+    std::string output;
+    decomp.decompress(output, compressed_data.data(), compressed_data.size());
+    CHECK(output == data);
+
+    SECTION("ISIZE larger than the limit throws")
+    {
+        gzip::Decompressor limited(data.size() - 1, true);
+        CHECK_THROWS_WITH(limited.decompress(output, compressed_data.data(), compressed_data.size()),
+                          Catch::Contains("size of output string will use more memory then intended when decompressing"));
+    }
+
+    SECTION("wrong ISIZE falls back to growing the output")
+    {
+        std::string tampered = compressed_data;
+        tampered[tampered.size() - 4] = 1;
+        tampered[tampered.size() - 3] = 0;
+        tampered[tampered.size() - 2] = 0;
+        tampered[tampered.size() - 1] = 0;
+        // inflate checks ISIZE against the produced length once it reaches the trailer
+        CHECK_THROWS_WITH(decomp.decompress(output, tampered.data(), tampered.size()), Catch::Contains("incorrect length check"));
+    }
+
+    SECTION("ISIZE beyond what the input can decode to is not believed")
+    {
+        std::string tiny = gzip::compress("hello", 5);
+        gzip::detail::put_le32(&tiny[tiny.size() - 4], 900000000u);
+        std::string small;
+        CHECK_THROWS_WITH(decomp.decompress(small, tiny.data(), tiny.size()), Catch::Contains("incorrect length check"));
+        CHECK(small.capacity() < 1000000);
+    }
+
+    SECTION("non gzip input has no ISIZE")
+    {
+        CHECK(!gzip::read_isize(data.data(), data.size(), isize));
+    }
+}
+
+TEST_CASE("decompress with each growth policy")
+{
+    std::string data;
+    for (int i = 0; i < 50000; ++i)
+    {
+        data += "hello hello hello hello ";
+    }
+    std::string compressed_data = gzip::compress(data.data(), data.size());
+    std::string output;
+
+    SECTION("geometric")
+    {
+        gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::geometric());
+        decomp.decompress(output, compressed_data.data(), compressed_data.size());
+        CHECK(output == data);
+    }
+
+    SECTION("fixed")
+    {
+        gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::fixed(4096));
+        decomp.decompress(output, compressed_data.data(), compressed_data.size());
+        CHECK(output == data);
+    }
+
+    SECTION("hint")
+    {
+        gzip::Decompressor decomp(1000000000, false, gzip::GrowthPolicy::hint(data.size()));
+        decomp.decompress(output, compressed_data.data(), compressed_data.size());
+        CHECK(output == data);
+    }
+
+    SECTION("output of exactly max_bytes fits")
+    {
+        gzip::Decompressor decomp(data.size());
+        decomp.decompress(output, compressed_data.data(), compressed_data.size());
+        CHECK(output == data);
+
+        gzip::Decompressor limited(data.size() - 1);
+        CHECK_THROWS(limited.decompress(output, compressed_data.data(), compressed_data.size()));
+        CHECK(output.empty());
+    }
+
+    SECTION("empty payload")
+    {
+        std::string compressed_empty = gzip::compress(data.data(), 0);
+        gzip::Decompressor decomp;
+        decomp.decompress(output, compressed_empty.data(), compressed_empty.size());
+        CHECK(output.empty());
+    }
+}
+
+TEST_CASE("decompress multiple gzip members")
+{
+    std::string a = "first member ";
+    std::string b;
+    for (int i = 0; i < 1000; ++i)
+    {
+        b += "second member ";
+    }
+    std::string c = "third";
+    std::string compressed_data = gzip::compress(a.data(), a.size()) +
+                                  gzip::compress(b.data(), b.size()) +
+                                  gzip::compress(c.data(), c.size());
+
+    CHECK(gzip::decompress(compressed_data.data(), compressed_data.size()) == a + b + c);
+
+    SECTION("member boundaries")
+    {
+        gzip::Decompressor decomp(1000000000, true);
+        std::string output;
+        std::vector<gzip::Member> members;
+        decomp.decompress(output, compressed_data.data(), compressed_data.size(), members);
+        CHECK(output == a + b + c);
+        REQUIRE(members.size() == 3);
+        CHECK(members[0].compressed_offset == 0);
+        CHECK(members[1].compressed_offset == members[0].compressed_size);
+        CHECK(members[2].compressed_offset + members[2].compressed_size == compressed_data.size());
+        CHECK(members[1].uncompressed_offset == a.size());
+        CHECK(members[1].uncompressed_size == b.size());
+        CHECK(members[2].uncompressed_offset == a.size() + b.size());
+
+        // each member decodes on its own
+        std::string second = gzip::decompress(compressed_data.data() + members[1].compressed_offset, members[1].compressed_size);
+        CHECK(second == b);
+    }
+
+    SECTION("trailing data that is not a member is ignored")
+    {
+        std::string padded = compressed_data + std::string(16, '\0');
+        CHECK(gzip::decompress(padded.data(), padded.size()) == a + b + c);
+    }
+
+    SECTION("corrupt second member throws")
+    {
+        std::string corrupt = compressed_data;
+        corrupt[gzip::compress(a.data(), a.size()).size() + 12] ^= 0x55;
+        CHECK_THROWS(gzip::decompress(corrupt.data(), corrupt.size()));
+    }
+}
+
 TEST_CASE("invalid decompression")
 {
     std::string data("this is a string that should be compressed data");
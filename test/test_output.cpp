@@ -0,0 +1,176 @@
+#include <catch.hpp>
+#include <gzip/bgzf.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/dictionary.hpp>
+#include <gzip/index.hpp>
+#include <gzip/output.hpp>
+#include <gzip/parallel_compress.hpp>
+#include <gzip/parallel_decompress.hpp>
+#include <gzip/speculative_decompress.hpp>
+#include "test_data.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define GZIP_TEST_PMR
+#endif
+#endif
+
+namespace {
+
+// A request buffer carved from a fixed arena that, like many network buffers, has no
+// resize: it reserves room at the tail, appends bytes written there and trims the end.
+class ArenaBuffer
+{
+    char* begin_;
+    std::size_t size_;
+    std::size_t capacity_;
+
+  public:
+    ArenaBuffer(char* arena, std::size_t capacity) : begin_(arena), size_(0), capacity_(capacity) {}
+
+    void reserve(std::size_t tailroom)
+    {
+        if (size_ + tailroom > capacity_)
+        {
+            throw std::length_error("arena exhausted");
+        }
+    }
+
+    void append(std::size_t length) { size_ += length; }
+    void trim_end(std::size_t length) { size_ -= length; }
+
+    char* writable_data() { return begin_; }
+    std::size_t length() const { return size_; }
+};
+
+} // namespace
+
+namespace gzip {
+
+template <>
+struct OutputTraits<ArenaBuffer>
+{
+    static std::size_t size(ArenaBuffer const& output) { return output.length(); }
+
+    static void resize(ArenaBuffer& output, std::size_t size)
+    {
+        if (size > output.length())
+        {
+            output.reserve(size - output.length());
+            output.append(size - output.length());
+        }
+        else
+        {
+            output.trim_end(output.length() - size);
+        }
+    }
+
+    static char* data(ArenaBuffer& output) { return output.writable_data(); }
+};
+
+} // namespace gzip
+
+TEST_CASE("output - byte vectors")
+{
+    std::string data = make_text(100000, 37);
+    std::string expected = gzip::compress(data.data(), data.size());
+
+    std::vector<std::uint8_t> compressed;
+    gzip::Compressor().compress(compressed, data.data(), data.size());
+    CHECK(std::string(compressed.begin(), compressed.end()) == expected);
+
+    std::vector<std::uint8_t> output;
+    gzip::Decompressor().decompress(output, reinterpret_cast<const char*>(compressed.data()), compressed.size());
+    CHECK(std::string(output.begin(), output.end()) == data);
+
+    std::vector<char> chars;
+    gzip::Decompressor().decompress(chars, expected.data(), expected.size());
+    CHECK(std::string(chars.begin(), chars.end()) == data);
+
+    // the dictionary trailer check reads the output back
+    gzip::Dictionary dictionary(make_text(3000, 37));
+    std::string dict_compressed;
+    gzip::Compressor(dictionary).compress(dict_compressed, data.data(), data.size());
+    gzip::Decompressor(dictionary).decompress(output, dict_compressed.data(), dict_compressed.size());
+    CHECK(std::string(output.begin(), output.end()) == data);
+}
+
+TEST_CASE("output - reserve and append buffers through traits")
+{
+    std::string data = make_text(50000, 37);
+    std::vector<char> arena(200000);
+
+    ArenaBuffer compressed(arena.data(), 100000);
+    gzip::Compressor().compress(compressed, data.data(), data.size());
+    CHECK(std::string(compressed.writable_data(), compressed.length()) == gzip::compress(data.data(), data.size()));
+
+    ArenaBuffer output(arena.data() + 100000, 100000);
+    gzip::Decompressor().decompress(output, compressed.writable_data(), compressed.length());
+    CHECK(std::string(output.writable_data(), output.length()) == data);
+
+    // a full arena surfaces as the buffer's own error
+    ArenaBuffer small(arena.data() + 100000, 1000);
+    CHECK_THROWS_AS(gzip::Decompressor().decompress(small, compressed.writable_data(), compressed.length()), std::length_error);
+}
+
+TEST_CASE("output - traits in the parallel, bgzf and indexed paths")
+{
+    std::string data = make_text(400000, 37);
+    std::vector<char> arena(8000000);
+    char* next = arena.data();
+    auto carve = [&](std::size_t capacity) {
+        ArenaBuffer buffer(next, capacity);
+        next += capacity;
+        return buffer;
+    };
+
+    ArenaBuffer compressed = carve(1000000);
+    gzip::ParallelCompressor(Z_DEFAULT_COMPRESSION, 2, 64 * 1024).compress(compressed, data.data(), data.size());
+    std::string parallel(compressed.writable_data(), compressed.length());
+    CHECK(gzip::decompress(parallel.data(), parallel.size()) == data);
+
+    ArenaBuffer speculative = carve(1000000);
+    gzip::SpeculativeDecompressor(2, 64 * 1024).decompress(speculative, parallel.data(), parallel.size());
+    CHECK(std::string(speculative.writable_data(), speculative.length()) == data);
+
+    gzip::Index index = gzip::Index::build(parallel.data(), parallel.size(), 100000);
+    ArenaBuffer whole = carve(1000000);
+    gzip::ParallelDecompressor(2).decompress(whole, parallel.data(), parallel.size(), index);
+    CHECK(std::string(whole.writable_data(), whole.length()) == data);
+    ArenaBuffer range = carve(300000);
+    gzip::IndexedDecompressor().decompress(range, parallel.data(), parallel.size(), index, 250000, 50000);
+    CHECK(std::string(range.writable_data(), range.length()) == data.substr(250000, 50000));
+
+    ArenaBuffer bgzf = carve(1000000);
+    gzip::BgzfCompressor(Z_DEFAULT_COMPRESSION, 2).compress(bgzf, data.data(), data.size());
+    gzip::BgzfReader reader(bgzf.writable_data(), bgzf.length(), 2);
+    ArenaBuffer all = carve(1000000);
+    reader.decompress(all);
+    CHECK(std::string(all.writable_data(), all.length()) == data);
+    ArenaBuffer part = carve(300000);
+    reader.read(part, reader.virtual_offset(123456), 70000);
+    CHECK(std::string(part.writable_data(), part.length()) == data.substr(123456, 70000));
+}
+
+#ifdef GZIP_TEST_PMR
+TEST_CASE("output - pmr strings from a monotonic buffer")
+{
+    std::string data = make_text(80000, 37);
+    std::vector<char> arena(400000);
+    std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size(), std::pmr::null_memory_resource());
+
+    std::pmr::string compressed(&resource);
+    gzip::Compressor().compress(compressed, data.data(), data.size());
+    std::pmr::string output(&resource);
+    gzip::Decompressor(1000000000, true).decompress(output, compressed.data(), compressed.size());
+    CHECK(std::string(output.data(), output.size()) == data);
+    CHECK(output.data() >= arena.data());
+    CHECK(output.data() < arena.data() + arena.size());
+}
+#endif
@@ -0,0 +1,104 @@
+#include <catch.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/index.hpp>
+#include <gzip/parallel_compress.hpp>
+#include <gzip/parallel_decompress.hpp>
+#include <gzip/utils.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("parallel compress - round trip")
+{
+    std::string data = make_text(1000000, 7);
+
+    for (std::size_t threads : {1, 2, 4})
+    {
+        gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, threads, 64 * 1024);
+        std::string compressed;
+        comp.compress(compressed, data.data(), data.size());
+        CHECK(gzip::is_compressed(compressed.data(), compressed.size()));
+        CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+    }
+}
+
+TEST_CASE("parallel compress - output does not depend on thread count")
+{
+    std::string data = make_text(500000, 7);
+    std::string one = gzip::compress_parallel(data.data(), data.size(), Z_DEFAULT_COMPRESSION, 1);
+    std::string many = gzip::compress_parallel(data.data(), data.size(), Z_DEFAULT_COMPRESSION, 8);
+    CHECK(one == many);
+
+    // the dictionary keeps the ratio close to single stream deflate
+    std::string serial = gzip::compress(data.data(), data.size());
+    CHECK(many.size() < serial.size() + serial.size() / 50);
+}
+
+TEST_CASE("parallel compress - edge cases")
+{
+    SECTION("empty input")
+    {
+        std::string compressed = gzip::compress_parallel("", 0);
+        CHECK(gzip::decompress(compressed.data(), compressed.size()).empty());
+    }
+
+    SECTION("input smaller than a block")
+    {
+        std::string data = "hello hello hello hello";
+        std::string compressed = gzip::compress_parallel(data.data(), data.size());
+        CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+    }
+
+    SECTION("input an exact multiple of the block size")
+    {
+        std::string data = make_text(4 * 32768, 7);
+        gzip::ParallelCompressor comp(Z_BEST_SPEED, 3, 32768);
+        std::string compressed;
+        comp.compress(compressed, data.data(), data.size());
+        CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+    }
+
+    SECTION("invalid level")
+    {
+        std::string data = make_text(300000, 7);
+        CHECK_THROWS_WITH(gzip::compress_parallel(data.data(), data.size(), 99, 4), Catch::Contains("deflate init failed"));
+    }
+}
+
+TEST_CASE("parallel decompress - round trip with an index")
+{
+    std::string data = make_text(1500000, 7);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 100000);
+    REQUIRE(index.checkpoints().size() > 4);
+
+    for (std::size_t threads : {1, 2, 4})
+    {
+        gzip::ParallelDecompressor decomp(threads);
+        std::string output;
+        decomp.decompress(output, compressed.data(), compressed.size(), index);
+        CHECK(output == data);
+    }
+
+    SECTION("into caller memory")
+    {
+        std::vector<char> buffer(data.size());
+        gzip::ParallelDecompressor decomp(3);
+        decomp.decompress_into(buffer.data(), buffer.size(), compressed.data(), compressed.size(), index);
+        CHECK(std::string(buffer.data(), buffer.size()) == data);
+        CHECK_THROWS_WITH(decomp.decompress_into(buffer.data(), buffer.size() - 1, compressed.data(), compressed.size(), index),
+                          Catch::Contains("output buffer is too small"));
+    }
+}
+
+TEST_CASE("parallel decompress - concatenated members and limits")
+{
+    std::string first = make_text(400000, 7);
+    std::string second = make_text(250000, 7);
+    std::string compressed = gzip::compress_parallel(first.data(), first.size()) + gzip::compress(second.data(), second.size());
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 64 * 1024);
+
+    CHECK(gzip::decompress_parallel(compressed.data(), compressed.size(), index, 4) == first + second);
+
+    gzip::ParallelDecompressor limited(2, 100000);
+    std::string output;
+    CHECK_THROWS_WITH(limited.decompress(output, compressed.data(), compressed.size(), index), Catch::Contains("more memory then intended"));
+}
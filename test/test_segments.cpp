@@ -0,0 +1,77 @@
+#include <catch.hpp>
+#include <gzip/buffer.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include "test_data.hpp"
+
+#include <vector>
+
+// Splits data into segments of growing sizes, including empty ones
+static std::vector<gzip::Segment> split_segments(std::string& data)
+{
+    std::vector<gzip::Segment> segments;
+    std::size_t offset = 0;
+    std::size_t length = 0;
+    while (offset < data.size())
+    {
+        length = std::min(length, data.size() - offset);
+        segments.push_back(gzip::Segment{&data[offset], length});
+        offset += length;
+        length = length * 2 + 1;
+    }
+    return segments;
+}
+
+TEST_CASE("segments - same output as the concatenation")
+{
+    gzip::Compressor comp;
+    for (std::size_t size : {std::size_t(1), std::size_t(5000), std::size_t(300000)})
+    {
+        std::string data = make_text(size, 31);
+        std::vector<gzip::Segment> segments = split_segments(data);
+        CHECK(segments.size() > 1);
+
+        std::string compressed;
+        comp.compress(compressed, segments.data(), segments.size());
+        CHECK(compressed == gzip::compress(data.data(), data.size()));
+        CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+
+        gzip::Buffer buffer;
+        comp.compress(buffer, segments.data(), segments.size());
+        CHECK(buffer.str() == compressed);
+    }
+}
+
+TEST_CASE("segments - empty input and raw framing")
+{
+    gzip::Compressor comp;
+    std::string compressed;
+    comp.compress(compressed, static_cast<gzip::Segment const*>(nullptr), 0);
+    CHECK(compressed == gzip::compress("", 0));
+
+    std::string empty;
+    gzip::Segment nothing = {&empty[0], 0};
+    comp.compress(compressed, &nothing, 1);
+    CHECK(gzip::decompress(compressed.data(), compressed.size()).empty());
+
+    std::string data = make_text(20000, 31);
+    std::vector<gzip::Segment> segments = split_segments(data);
+    gzip::BasicCompressor<gzip::RawFormat<>> raw;
+    raw.compress(compressed, segments.data(), segments.size());
+    std::string expected;
+    raw.compress(expected, data.data(), data.size());
+    CHECK(compressed == expected);
+}
+
+TEST_CASE("segments - incompressible input grows the output")
+{
+    std::string data = make_noise(100000, 7);
+    std::vector<gzip::Segment> segments = split_segments(data);
+    std::string compressed;
+    gzip::Compressor().compress(compressed, segments.data(), segments.size());
+    CHECK(compressed.size() > data.size());
+    CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+
+    gzip::Compressor limited(Z_DEFAULT_COMPRESSION, data.size() - 1);
+    CHECK_THROWS_WITH(limited.compress(compressed, segments.data(), segments.size()), "size may use more memory than intended when decompressing");
+}
@@ -0,0 +1,98 @@
+#include <catch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/parallel_compress.hpp>
+#include <gzip/speculative_decompress.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("speculative decompress - matches serial decompression")
+{
+    std::string data = make_text(3000000, 3);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    REQUIRE(compressed.size() > 4 * 64 * 1024);
+
+    for (std::size_t threads : {1, 3})
+    {
+        gzip::SpeculativeDecompressor decomp(threads, 64 * 1024);
+        std::string output;
+        CHECK(decomp.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == data);
+    }
+}
+
+TEST_CASE("speculative decompress - input it falls back on")
+{
+    std::string data = make_text(1000000, 3);
+
+    SECTION("small input")
+    {
+        std::string compressed = gzip::compress("hello hello", 11);
+        CHECK(gzip::decompress_speculative(compressed.data(), compressed.size()) == "hello hello");
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024);
+        std::string output;
+        CHECK_FALSE(decomp.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == "hello hello");
+    }
+
+    SECTION("concatenated members")
+    {
+        std::string compressed = gzip::compress(data.data(), data.size()) + gzip::compress(data.data(), data.size());
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024);
+        std::string output;
+        CHECK_FALSE(decomp.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == data + data);
+    }
+
+    SECTION("stored blocks only")
+    {
+        std::string compressed = gzip::compress(data.data(), data.size(), Z_NO_COMPRESSION);
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024);
+        std::string output;
+        CHECK_FALSE(decomp.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == data);
+    }
+
+    SECTION("zlib framing")
+    {
+        std::string compressed = gzip::compress_parallel(data.data(), data.size());
+        compressed[0] = 'x';
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024);
+        std::string output;
+        CHECK_THROWS(decomp.decompress(output, compressed.data(), compressed.size()));
+    }
+}
+
+TEST_CASE("speculative decompress - errors")
+{
+    std::string data = make_text(2000000, 3);
+    std::string compressed = gzip::compress(data.data(), data.size());
+
+    SECTION("corrupt trailer")
+    {
+        compressed[compressed.size() - 6] ^= 0x55;
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024);
+        std::string output;
+        CHECK_THROWS(decomp.decompress(output, compressed.data(), compressed.size()));
+    }
+
+    SECTION("chunk output counts against max_bytes")
+    {
+        // the later chunks are decoded twice, so their output is counted twice
+        gzip::SpeculativeDecompressor roomy(2, 64 * 1024, 3 * data.size());
+        std::string output;
+        CHECK(roomy.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == data);
+
+        gzip::SpeculativeDecompressor tight(2, 64 * 1024, data.size() + data.size() / 2);
+        CHECK_FALSE(tight.decompress(output, compressed.data(), compressed.size()));
+        CHECK(output == data);
+    }
+
+    SECTION("output above max_bytes")
+    {
+        // the serial decoder the speculative one falls back to reports the limit
+        gzip::SpeculativeDecompressor decomp(2, 64 * 1024, data.size() / 2);
+        std::string output;
+        CHECK_THROWS_WITH(decomp.decompress(output, compressed.data(), compressed.size()), Catch::Contains("more memory then intended"));
+    }
+}
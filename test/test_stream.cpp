@@ -0,0 +1,231 @@
+#include <catch.hpp>
+#include <gzip/compress.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/stream_compress.hpp>
+#include <gzip/stream_decompress.hpp>
+#include <gzip/utils.hpp>
+#include "test_data.hpp"
+
+TEST_CASE("stream compress - round trip")
+{
+    std::string data = make_text(1000000);
+    std::string compressed;
+    std::size_t chunks = 0;
+    std::size_t largest_chunk = 0;
+    gzip::StreamCompressor comp([&](const char* chunk, std::size_t size) {
+        compressed.append(chunk, size);
+        ++chunks;
+        largest_chunk = std::max(largest_chunk, size);
+    },
+                                Z_DEFAULT_COMPRESSION, 4096);
+
+    // feed the input in uneven pieces
+    std::size_t offset = 0;
+    std::size_t piece = 1;
+    while (offset < data.size())
+    {
+        std::size_t n = std::min(piece, data.size() - offset);
+        comp.write(data.data() + offset, n);
+        offset += n;
+        piece = piece * 3 + 1;
+    }
+    comp.finish();
+
+    CHECK(gzip::is_compressed(compressed.data(), compressed.size()));
+    CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+    CHECK(chunks > 1);
+    CHECK(largest_chunk <= 4096);
+}
+
+TEST_CASE("stream compress - flush makes written data decodable")
+{
+    std::string compressed;
+    gzip::StreamCompressor comp([&](const char* chunk, std::size_t size) {
+        compressed.append(chunk, size);
+    });
+
+    comp.write("hello hello hello");
+    comp.flush();
+    comp.flush();
+    REQUIRE(!compressed.empty());
+
+    // a sync flushed prefix inflates without the trailer
+    z_stream inflate_s = z_stream();
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+    REQUIRE(inflateInit2(&inflate_s, 15 + 16) == Z_OK);
+#pragma GCC diagnostic pop
+    char out[64];
+    inflate_s.next_in = reinterpret_cast<z_const Bytef*>(compressed.data());
+    inflate_s.avail_in = static_cast<unsigned int>(compressed.size());
+    inflate_s.next_out = reinterpret_cast<Bytef*>(out);
+    inflate_s.avail_out = sizeof(out);
+    CHECK(inflate(&inflate_s, Z_SYNC_FLUSH) == Z_OK);
+    CHECK(std::string(out, sizeof(out) - inflate_s.avail_out) == "hello hello hello");
+    inflateEnd(&inflate_s);
+
+    comp.write(" world");
+    comp.finish();
+    CHECK(gzip::decompress(compressed.data(), compressed.size()) == "hello hello hello world");
+}
+
+TEST_CASE("stream compress - matches Compressor output")
+{
+    std::string data = make_text(50000);
+    std::string compressed;
+    gzip::StreamCompressor comp([&](const char* chunk, std::size_t size) {
+        compressed.append(chunk, size);
+    });
+    comp.write(data);
+    comp.finish();
+    CHECK(compressed == gzip::compress(data.data(), data.size()));
+
+    SECTION("finish starts a new member")
+    {
+        compressed.clear();
+        comp.write(data);
+        comp.finish();
+        CHECK(compressed == gzip::compress(data.data(), data.size()));
+    }
+
+    SECTION("no member without a write")
+    {
+        compressed.clear();
+        comp.flush();
+        comp.finish();
+        CHECK(compressed.empty());
+    }
+
+    SECTION("empty member")
+    {
+        std::string empty;
+        gzip::StreamCompressor fresh([&](const char* chunk, std::size_t size) {
+            empty.append(chunk, size);
+        });
+        fresh.flush();
+        fresh.finish();
+        fresh.finish();
+        CHECK(empty == gzip::compress("", 0));
+    }
+}
+
+TEST_CASE("stream decompress - round trip in small pieces")
+{
+    std::string data = make_text(1000000);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    std::string output;
+    std::size_t chunks = 0;
+    std::size_t short_chunks = 0;
+    gzip::StreamDecompressor decomp([&](const char* chunk, std::size_t size) {
+        output.append(chunk, size);
+        ++chunks;
+        if (size != 8192) ++short_chunks;
+    },
+                                    1000000000, 8192);
+
+    for (std::size_t offset = 0; offset < compressed.size(); offset += 100)
+    {
+        decomp.write(compressed.data() + offset, std::min<std::size_t>(100, compressed.size() - offset));
+    }
+    CHECK(decomp.done());
+    decomp.finish();
+
+    CHECK(output == data);
+    CHECK(decomp.total_out() == data.size());
+    CHECK(chunks == (data.size() + 8191) / 8192);
+    CHECK(short_chunks <= 1);
+}
+
+TEST_CASE("stream decompress - running output limit")
+{
+    std::string data = make_text(1000000);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    std::size_t received = 0;
+    gzip::StreamDecompressor decomp([&](const char*, std::size_t size) {
+        received += size;
+    },
+                                    100000, 4096);
+
+    CHECK_THROWS_WITH(decomp.write(compressed), Catch::Contains("size of output will use more memory then intended when decompressing"));
+    CHECK(received <= 100000);
+}
+
+TEST_CASE("stream decompress - errors")
+{
+    std::string data = make_text(5000);
+    std::string compressed = gzip::compress(data.data(), data.size());
+    std::string output;
+    gzip::StreamDecompressor decomp([&](const char* chunk, std::size_t size) {
+        output.append(chunk, size);
+    });
+
+    SECTION("truncated input")
+    {
+        decomp.write(compressed.data(), compressed.size() / 2);
+        CHECK(!decomp.done());
+        CHECK_THROWS_WITH(decomp.finish(), Catch::Contains("truncated"));
+
+        // the next write starts over
+        output.clear();
+        decomp.write(compressed);
+        decomp.finish();
+        CHECK(output == data);
+    }
+
+    SECTION("invalid input")
+    {
+        CHECK_THROWS(decomp.write(data));
+    }
+}
+
+TEST_CASE("stream decompress - concatenated members")
+{
+    std::string first = make_text(30000, 3);
+    std::string second = make_text(100, 4);
+    std::string compressed = gzip::compress(first.data(), first.size()) + gzip::compress(second.data(), second.size()) + gzip::compress("", 0);
+    std::string output;
+    gzip::StreamDecompressor decomp([&](const char* chunk, std::size_t size) {
+        output.append(chunk, size);
+    },
+                                    1000000000, 4096);
+
+    // piece sizes of 1 split the magic bytes of the next member across writes
+    for (std::size_t piece : {std::size_t(1), std::size_t(7), std::size_t(1000), compressed.size()})
+    {
+        output.clear();
+        for (std::size_t offset = 0; offset < compressed.size(); offset += piece)
+        {
+            decomp.write(compressed.data() + offset, std::min(piece, compressed.size() - offset));
+        }
+        decomp.finish();
+        CHECK(output == first + second);
+        CHECK(decomp.total_out() == first.size() + second.size());
+    }
+
+    SECTION("a truncated second member")
+    {
+        output.clear();
+        decomp.write(compressed.data(), compressed.size() - 30);
+        CHECK_THROWS_WITH(decomp.finish(), Catch::Contains("truncated"));
+    }
+
+    SECTION("trailing bytes that are not a member are ignored")
+    {
+        output.clear();
+        std::string trailing = gzip::compress(first.data(), first.size()) + std::string("\x1f\x00garbage", 9);
+        decomp.write(trailing);
+        decomp.write(compressed);
+        decomp.finish();
+        CHECK(output == first);
+    }
+
+    SECTION("a zlib stream ends at its end")
+    {
+        output.clear();
+        std::string zlib;
+        gzip::BasicCompressor<gzip::ZlibFormat<>>().compress(zlib, first.data(), first.size());
+        decomp.write(zlib + compressed);
+        decomp.finish();
+        CHECK(output == first);
+    }
+}
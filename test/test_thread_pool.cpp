@@ -0,0 +1,186 @@
+#include <catch.hpp>
+#include <gzip/batch.hpp>
+#include <gzip/bgzf.hpp>
+#include <gzip/decompress.hpp>
+#include <gzip/index.hpp>
+#include <gzip/parallel_compress.hpp>
+#include <gzip/parallel_decompress.hpp>
+#include <gzip/speculative_decompress.hpp>
+#include <gzip/thread_pool.hpp>
+#include "test_data.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+// Runs tasks inline on the calling thread, the smallest possible custom executor
+class InlineExecutor : public gzip::Executor
+{
+  public:
+    std::size_t submitted = 0;
+
+    std::size_t concurrency() const override { return 2; }
+
+    void submit(std::function<void()> task) override
+    {
+        ++submitted;
+        task();
+    }
+};
+
+TEST_CASE("thread pool - submit and wait")
+{
+    gzip::ThreadPool pool(4);
+    CHECK(pool.concurrency() == 4);
+
+    std::atomic<std::size_t> sum(0);
+    for (std::size_t i = 1; i <= 1000; ++i)
+    {
+        pool.submit([&sum, i]() { sum += i; });
+    }
+    pool.wait();
+    CHECK(sum == 500500);
+
+    // tasks submitted from inside a task land on the worker's own queue
+    std::atomic<std::size_t> nested(0);
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        pool.submit([&pool, &nested]() {
+            for (std::size_t j = 0; j < 10; ++j)
+            {
+                pool.submit([&nested]() { ++nested; });
+            }
+        });
+    }
+    pool.wait();
+    CHECK(nested == 100);
+}
+
+TEST_CASE("thread pool - wait covers nested submits")
+{
+    // a parent task is still running while its children can already be stolen and
+    // finished by other workers; wait() must not return before the parent is done
+    gzip::ThreadPool pool(4);
+    for (int round = 0; round < 2000; ++round)
+    {
+        std::atomic<std::size_t> finished(0);
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            pool.submit([&pool, &finished]() {
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    pool.submit([&pool, &finished]() {
+                        pool.submit([&finished]() { ++finished; });
+                        ++finished;
+                    });
+                    std::this_thread::yield();
+                }
+                ++finished;
+            });
+        }
+        pool.wait();
+        REQUIRE(finished == 3 * (1 + 4 * 2));
+    }
+}
+
+TEST_CASE("thread pool - exceptions are rethrown by wait")
+{
+    gzip::ThreadPool pool(2);
+    std::atomic<std::size_t> ran(0);
+    for (std::size_t i = 0; i < 20; ++i)
+    {
+        pool.submit([&ran, i]() {
+            ++ran;
+            if (i == 7)
+            {
+                throw std::runtime_error("task failed");
+            }
+        });
+    }
+    CHECK_THROWS_WITH(pool.wait(), "task failed");
+    CHECK(ran == 20);
+    // the error is reported once
+    pool.wait();
+}
+
+TEST_CASE("thread pool - parallel classes run on a shared pool")
+{
+    std::string data = make_text(2000000, 11);
+    gzip::ThreadPool pool(3, true);
+
+    gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, 0, 64 * 1024, 2000000000, &pool);
+    std::string compressed;
+    comp.compress(compressed, data.data(), data.size());
+    std::string serial;
+    gzip::ParallelCompressor(Z_DEFAULT_COMPRESSION, 1, 64 * 1024).compress(serial, data.data(), data.size());
+    CHECK(compressed == serial);
+
+    gzip::Index index = gzip::Index::build(compressed.data(), compressed.size(), 128 * 1024);
+    gzip::ParallelDecompressor decomp(0, 1000000000, &pool);
+    std::string output;
+    decomp.decompress(output, compressed.data(), compressed.size(), index);
+    CHECK(output == data);
+
+    gzip::SpeculativeDecompressor speculative(0, 64 * 1024, 1000000000, &pool);
+    output.clear();
+    speculative.decompress(output, compressed.data(), compressed.size());
+    CHECK(output == data);
+
+    std::string bgzf;
+    gzip::BgzfCompressor(Z_DEFAULT_COMPRESSION, 0, 2000000000, &pool).compress(bgzf, data.data(), data.size());
+    gzip::BgzfReader reader(bgzf.data(), bgzf.size(), 0, 1000000000, &pool);
+    output.clear();
+    reader.decompress(output);
+    CHECK(output == data);
+
+    std::vector<gzip::BufferView> views;
+    for (std::size_t at = 0; at < data.size(); at += 10000)
+    {
+        views.push_back(gzip::BufferView{data.data() + at, std::min<std::size_t>(10000, data.size() - at)});
+    }
+    gzip::BatchOutput packed;
+    gzip::BatchCompressor(Z_DEFAULT_COMPRESSION, 0, 2000000000, &pool).compress(packed, views);
+    std::vector<gzip::BufferView> items;
+    for (std::size_t i = 0; i < packed.size(); ++i)
+    {
+        items.push_back(packed[i]);
+    }
+    gzip::BatchOutput unpacked;
+    gzip::BatchDecompressor(0, 1000000000, &pool).decompress(unpacked, items);
+    CHECK(unpacked.arena() == data);
+}
+
+TEST_CASE("thread pool - parallel calls from inside pool tasks")
+{
+    std::string data = make_text(500000, 11);
+    std::string expected;
+    gzip::ParallelCompressor(Z_DEFAULT_COMPRESSION, 1, 32 * 1024).compress(expected, data.data(), data.size());
+    gzip::ThreadPool pool(2);
+
+    // every task waits on work it submits to the same pool; the calling thread always
+    // takes part, so this finishes even when all workers are busy
+    std::vector<std::string> results(8);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        pool.submit([&, i]() {
+            gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, 0, 32 * 1024, 2000000000, &pool);
+            comp.compress(results[i], data.data(), data.size());
+        });
+    }
+    pool.wait();
+    for (auto const& result : results)
+    {
+        CHECK(result == expected);
+    }
+}
+
+TEST_CASE("thread pool - custom executor")
+{
+    std::string data = make_text(300000, 11);
+    InlineExecutor executor;
+    gzip::ParallelCompressor comp(Z_DEFAULT_COMPRESSION, 0, 32 * 1024, 2000000000, &executor);
+    std::string compressed;
+    comp.compress(compressed, data.data(), data.size());
+    CHECK(executor.submitted == 2);
+    CHECK(gzip::decompress(compressed.data(), compressed.size()) == data);
+}